@@ -14,24 +14,63 @@
 
 /*---------------------------------------------------------------------------*/
 #include "nd.h"
+#include "nd-log.h"
 /*---------------------------------------------------------------------------*/
+/* ND primitive started, one of the ND_ modes with its flags. Builds for
+ * other modes set APP_CONF_ND_MODE instead of editing nd_start() below. */
+#ifdef APP_CONF_ND_MODE
+#define APP_ND_MODE APP_CONF_ND_MODE
+#else
+#define APP_ND_MODE ND_BURST
+#endif
+
+/* With APP_CONF_ND_BUDGET_PPM the mode is started by nd_start_with_budget()
+ * for that duty cycle [parts per million] instead */
+/*---------------------------------------------------------------------------*/
+/* The callbacks queue log records that nd_log_process prints later, see
+ * nd-log.h */
 static void
-nd_new_nbr_cb(uint16_t epoch, uint8_t nbr_id)
+nd_new_nbr_cb(uint16_t epoch, uint16_t nbr_id)
 {
-  printf("App: Epoch %u New NBR %u\n",
-         epoch, nbr_id);
+  uint16_t v[] = {epoch, nbr_id};
+  nd_log_write(ND_LOG_NEW_NBR, v, 2);
 }
 /*---------------------------------------------------------------------------*/
 static void
 nd_epoch_end_cb(uint16_t epoch, uint8_t num_nbr, uint8_t num_new_nbr)
 {
-  printf("App: Epoch %u finished Num NBR %u Num new NBR %u\n",
-         epoch, num_nbr, num_new_nbr);
+  uint16_t v[] = {epoch, num_nbr, num_new_nbr};
+  nd_log_write(ND_LOG_EPOCH_END, v, 3);
+}
+/*---------------------------------------------------------------------------*/
+static void
+nd_epoch_report_cb(uint16_t epoch, const struct nd_epoch_stats *stats)
+{
+  uint16_t listen[] = {epoch, stats->listen_ticks, stats->listen_target,
+                       stats->listen_level, stats->candidates, stats->gossip_hits};
+  uint16_t tx[] = {epoch, stats->tx_sent, stats->tx_busy, stats->tx_collisions,
+                   stats->tx_backoffs, stats->tx_dropped, stats->rx_dropped};
+  // radio time of each phase: transmitting, then listening [ticks]
+  uint16_t radio[] = {epoch,
+                      stats->radio_tx[ND_PHASE_IDLE], stats->radio_rx[ND_PHASE_IDLE],
+                      stats->radio_tx[ND_PHASE_TX], stats->radio_rx[ND_PHASE_TX],
+                      stats->radio_tx[ND_PHASE_RX], stats->radio_rx[ND_PHASE_RX],
+                      stats->radio_tx[ND_PHASE_LAST], stats->radio_rx[ND_PHASE_LAST]};
+
+  nd_log_write(ND_LOG_LISTEN, listen, 6);
+  nd_log_write(ND_LOG_TX, tx, 7);
+  nd_log_write(ND_LOG_RADIO, radio, 9);
+  if (stats->rx_channel != 0)
+  {
+    uint16_t hop[] = {epoch, stats->tx_channel, stats->rx_channel};
+    nd_log_write(ND_LOG_HOP, hop, 3);
+  }
 }
 /*---------------------------------------------------------------------------*/
 struct nd_callbacks rcb = {
     .nd_new_nbr = nd_new_nbr_cb,
-    .nd_epoch_end = nd_epoch_end_cb};
+    .nd_epoch_end = nd_epoch_end_cb,
+    .nd_epoch_report = nd_epoch_report_cb};
 /*---------------------------------------------------------------------------*/
 PROCESS(app_process, "Application process");
 AUTOSTART_PROCESSES(&app_process);
@@ -54,7 +93,7 @@ PROCESS_THREAD(app_process, ev, data)
   printf("RTIMER_SECOND: %u\n", RTIMER_SECOND);
 
   /* Begin with radio off */
-  NETSTACK_RADIO.off();
+  NETSTACK_RDC.off(0);
 
   /* Configure radio filtering */
   NETSTACK_RADIO.set_value(RADIO_PARAM_RX_MODE, 0);
@@ -64,7 +103,14 @@ PROCESS_THREAD(app_process, ev, data)
   PROCESS_WAIT_UNTIL(etimer_expired(&et));
 
   /* Start ND Primitive */
-  nd_start(ND_BURST, &rcb);
+#ifdef APP_CONF_ND_BUDGET_PPM
+  if (nd_start_with_budget(APP_ND_MODE, APP_CONF_ND_BUDGET_PPM, EPOCH_INTERVAL_RT, &rcb) < 0)
+  {
+    printf("App: ND not started\n");
+  }
+#else
+  nd_start(APP_ND_MODE, &rcb);
+#endif
   //nd_start(ND_SCATTER, &rcb);
 
   /* Do nothing else */
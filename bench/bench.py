@@ -0,0 +1,201 @@
+"""Scalability benchmark: generates topologies from the nd-test-mrm-*.csc
+files, runs them headless in parallel and reports discovery ratio, latency
+and duty cycle against the number of nodes.
+
+    python3 bench.py -n 10 50 100 200 --seeds 1 2 3
+    python3 bench.py -n 100 --layout grid --runner cooja \\
+        --cooja "java -jar /contiki/tools/cooja/dist/cooja.jar -nogui={csc} -contiki=/contiki" \\
+        --firmware BURST=../app-burst.sky SCATTER=../app-scatter.sky
+
+With the default runner the logs come from sim/nd-sim, built once per mode.
+Cooja runs each simulation in its own directory, where the ScriptRunner of
+the template writes test.log.
+"""
+import argparse
+import math
+import os
+import re
+import subprocess
+import sys
+from concurrent.futures import ThreadPoolExecutor
+from os.path import abspath, dirname, join
+
+import numpy as np
+
+ROOT = abspath(join(dirname(__file__), ".."))
+sys.path.insert(0, join(ROOT, "parser"))
+import parser as nd_parser  # noqa: E402
+
+TEMPLATE = join(ROOT, "nd-test-mrm-50n.csc")
+OUT_FOLDER = join(ROOT, "bench", "out")
+MODES = {"BURST": "ND_BURST", "SCATTER": "ND_SCATTER"}
+
+MOTE_REGEX = re.compile(r"    <mote>.*?</mote>\n", re.S)
+POSITION_REGEX = re.compile(r"<x>([-\d.eE]+)</x>\s*<y>([-\d.eE]+)</y>")
+
+
+def template_parts(text):
+    """Splits a .csc into what precedes the motes, one mote and what follows"""
+    motes = list(MOTE_REGEX.finditer(text))
+    if not motes:
+        raise ValueError("no <mote> in the template")
+    return text[:motes[0].start()], motes[0].group(0), text[motes[-1].end():], motes
+
+
+def template_side(text) -> tuple[float, int]:
+    """Side of the square the template's motes are spread over, and their number"""
+    pos = np.array([[float(x), float(y)] for x, y in POSITION_REGEX.findall(text)])
+    side = max(np.ptp(pos[:, 0]), np.ptp(pos[:, 1])) if len(pos) > 1 else 0.0
+    return side, len(pos)
+
+
+def positions(n, side, layout, rng) -> np.ndarray:
+    if layout == "grid":
+        cols = math.ceil(math.sqrt(n))
+        step = side / max(cols - 1, 1)
+        return np.array([[(i % cols) * step, (i // cols) * step] for i in range(n)])
+    return rng.uniform(0.0, side, size=(n, 2))
+
+
+def retarget_csc(text, seed, firmware=None, timeout_ms=None) -> str:
+    """A .csc with a fixed random seed, and optionally another firmware and
+    script timeout"""
+    text = text.replace("<randomseed>generated</randomseed>", f"<randomseed>{seed}</randomseed>")
+    if firmware is not None:
+        text = re.sub(r"<firmware EXPORT=\"copy\">.*?</firmware>",
+                      f"<firmware EXPORT=\"copy\">{abspath(firmware)}</firmware>", text)
+    if timeout_ms is not None:
+        text = re.sub(r"TIMEOUT\(\d+\)", f"TIMEOUT({timeout_ms})", text)
+    return text
+
+
+def gen_csc(n, seed, layout="random", side=None, template=TEMPLATE, firmware=None, timeout_ms=None) -> str:
+    """Text of a .csc of n motes with ids 1..n, derived from template. side
+    defaults to the template's area scaled to keep its density."""
+    with open(template) as f:
+        text = f.read()
+    head, mote, tail, _ = template_parts(retarget_csc(text, seed, firmware, timeout_ms))
+    if side is None:
+        t_side, t_n = template_side(text)
+        side = t_side * math.sqrt(n / t_n)
+    head = re.sub(r"<title>.*?</title>", f"<title>bench {n} nodes seed {seed} {layout}</title>", head)
+
+    motes = []
+    for i, (x, y) in enumerate(positions(n, side, layout, np.random.default_rng(seed)), start=1):
+        m = re.sub(r"<x>.*?</x>", f"<x>{x!r}</x>", mote)
+        m = re.sub(r"<y>.*?</y>", f"<y>{y!r}</y>", m)
+        m = re.sub(r"<id>\d+</id>", f"<id>{i}</id>", m)
+        motes.append(m)
+    return head + "".join(motes) + tail
+
+
+def build_sim(mode, defines=(), name=None) -> str:
+    """nd-sim built for mode with the ND_DEFINES given, in a build directory
+    of its own"""
+    name = name or mode.lower()
+    defines = [f"APP_CONF_ND_MODE={MODES[mode]}"] + list(defines)
+    subprocess.run(["make", "-s", "-C", join(ROOT, "sim"), f"BUILD=build/{name}", f"SIM=nd-sim-{name}",
+                    "ND_DEFINES=" + " ".join(defines)], check=True)
+    return join(ROOT, "sim", f"nd-sim-{name}")
+
+
+def run_sim(binary, csc, seed, args, log):
+    with open(log + ".err", "w") as err:
+        subprocess.run([binary, "-c", csc, "-s", str(seed), "-t", str(args.time), "-r", str(args.range),
+                        "-o", log] + args.sim_args, check=True, stderr=err)
+
+
+def run_cooja(csc, run_dir, args, log):
+    with open(join(run_dir, "cooja.out"), "w") as out:
+        subprocess.run(args.cooja.format(csc=csc), shell=True, cwd=run_dir, check=True,
+                       stdout=out, stderr=subprocess.STDOUT)
+    os.replace(join(run_dir, "test.log"), log)
+
+
+def run(args):
+    os.makedirs(args.out, exist_ok=True)
+    firmware = dict(f.split("=", 1) for f in args.firmware)
+    binaries = {m: build_sim(m) for m in args.modes} if args.runner == "sim" else {}
+
+    jobs = []
+    for mode in args.modes:
+        for n in args.nodes:
+            for seed in args.seeds:
+                name = f"{mode}_{n}_{args.layout}_{seed}"
+                run_dir = join(args.out, name)
+                os.makedirs(run_dir, exist_ok=True)
+                csc = join(run_dir, "sim.csc")
+                log = join(args.out, name + ".log")
+                with open(csc, "w") as f:
+                    f.write(gen_csc(n, seed, args.layout, args.side, args.template,
+                                    firmware.get(mode), int(args.time * 1000)))
+                jobs.append((mode, n, seed, csc, run_dir, log))
+
+    def one(job):
+        mode, n, seed, csc, run_dir, log = job
+        if args.runner == "sim":
+            run_sim(binaries[mode], csc, seed, args, log)
+        else:
+            run_cooja(csc, run_dir, args, log)
+        print(f"done {mode} {n} nodes seed {seed}", flush=True)
+
+    with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        list(pool.map(one, jobs))
+    return jobs
+
+
+def report(jobs, out):
+    """Parses the logs in parallel, prints the scaling table and writes it as CSV"""
+    exps = nd_parser.parse_all([job[5] for job in jobs])
+
+    rows = {}
+    for (mode, n, seed, *_), e in zip(jobs, exps):
+        lat = e.latency if len(e.latency) else np.array([np.nan])
+        rows.setdefault((mode, n), []).append(
+            (e.avg_n_count_epoch_overall_percentage, np.median(lat), np.percentile(lat, 90), e.dc_mean,
+             e.asymmetric_pairs / max(e.linked_pairs, 1)))
+
+    header = "mode,nodes,runs,discovery_ratio,latency_median_s,latency_p90_s,duty_cycle_pct,one_way_links"
+    lines = [header]
+    print("\n{:8s} {:>6s} {:>5s} {:>10s} {:>10s} {:>10s} {:>8s} {:>8s}".format(
+        "mode", "nodes", "runs", "discovery", "lat p50", "lat p90", "dc %", "one way"))
+    for (mode, n), v in sorted(rows.items()):
+        m = np.mean(np.array(v, dtype=float), axis=0)
+        lines.append(f"{mode},{n},{len(v)}," + ",".join(f"{x:.4f}" for x in m))
+        print("{:8s} {:6d} {:5d} {:10.4f} {:10.3f} {:10.3f} {:8.3f} {:8.4f}".format(mode, n, len(v), *m))
+
+    with open(join(out, "report.csv"), "w") as f:
+        f.write("\n".join(lines) + "\n")
+    print(f"\nSaved to {join(out, 'report.csv')}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("-n", "--nodes", type=int, nargs="+", default=[10, 50, 100])
+    ap.add_argument("--modes", nargs="+", choices=sorted(MODES), default=sorted(MODES))
+    ap.add_argument("--seeds", type=int, nargs="+", default=[1])
+    ap.add_argument("--layout", choices=["random", "grid"], default="random")
+    ap.add_argument("--side", type=float, help="side of the area [m], default keeps the template's density")
+    ap.add_argument("--template", default=TEMPLATE)
+    ap.add_argument("-t", "--time", type=float, default=200, help="simulated time [s]")
+    ap.add_argument("-r", "--range", type=float, default=400, help="nd-sim transmission range [m]")
+    ap.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    ap.add_argument("--runner", choices=["sim", "cooja"], default="sim")
+    ap.add_argument("--cooja", help="Cooja command line, {csc} is the simulation file")
+    ap.add_argument("--firmware", nargs="*", default=[], help="MODE=firmware for Cooja, one per mode")
+    ap.add_argument("--sim-args", nargs=argparse.REMAINDER, default=[], help="more nd-sim options")
+    ap.add_argument("-o", "--out", default=OUT_FOLDER)
+    args = ap.parse_args()
+
+    if args.runner == "cooja":
+        if not args.cooja:
+            ap.error("--runner cooja needs --cooja")
+        missing = set(args.modes) - {f.split("=", 1)[0] for f in args.firmware}
+        if missing:
+            ap.error("--runner cooja needs --firmware for " + " ".join(sorted(missing)))
+
+    report(run(args), args.out)
+
+
+if __name__ == "__main__":
+    main()
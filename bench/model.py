@@ -0,0 +1,187 @@
+"""Analytical model of the BURST and SCATTER schedules: derives the
+configuration nd_start() compiles from the ND_CONF_* values as nd.c does,
+checks it as the ND_STATIC_ASSERT() lines of nd.c do, and predicts the duty
+cycle and, for a pair of nodes at a uniformly random phase, the probability
+of hearing each other within an epoch and the discovery latency. Collisions, losses
+and the adaptive, gossip, rendezvous and hop flags are not modelled.
+
+    python3 model.py --modes BURST SCATTER -D ND_CONF_RECEPTION_WINDOW_COUNT_BURST=6
+"""
+import argparse
+import sys
+from dataclasses import dataclass
+
+import numpy as np
+
+RTIMER_SECOND = 32768  # sky and zoul alike
+SCHEDULE_MAX = 48  # ND_SCHEDULE_MAX
+EPOCH_TICKS_MAX = 0x8000
+
+
+@dataclass
+class Config:
+    """Windows of a mode, as in the START line, plus what the model needs [ticks]"""
+    mode: str
+    epoch: int
+    tx_window_count: int
+    rx_window_count: int
+    window: int
+    tx_per_window: int
+    tx_spacing: int
+    listen: int
+    beacon: int
+    jitter_max: int
+    rtimer_second: int
+    defines: dict
+
+
+def define(defines, name, default) -> int:
+    """Value of ND_CONF_<name>, integers only"""
+    v = defines.get("ND_CONF_" + name)
+    return default if v is None else int(v, 0)
+
+
+def config(mode, defines=None, rtimer_second=RTIMER_SECOND) -> Config:
+    """The configuration nd_start(mode) compiles, see the macros of nd.c"""
+    defines = dict(defines or {})
+    ms = rtimer_second // 1000
+    epoch = define(defines, "EPOCH_INTERVAL_RT", rtimer_second)
+    if mode == "BURST":
+        tx_count = 1
+        rx_count = define(defines, "RECEPTION_WINDOW_COUNT_BURST", 10)
+        window = epoch // max(tx_count + rx_count, 1)
+        spacing = define(defines, "TRANSMISSION_DURATION_BURST", 15 * ms)
+        per_window = window // spacing if spacing else 0
+        listen = window // 4
+    elif mode == "SCATTER":
+        rx_count = 1
+        tx_count = (epoch * 10) // rtimer_second - rx_count
+        window = epoch // max(tx_count + rx_count, 1)
+        spacing = 100 * ms
+        per_window = 1
+        listen = define(defines, "RECEPTION_DURATION_SCATTER", window)
+    else:
+        raise ValueError(f"no model of {mode}")
+    return Config(mode, epoch, tx_count, rx_count, window, per_window, spacing, listen,
+                  (rtimer_second * 6) // 10000, define(defines, "COLLISION_OFFSET_MAX", 10 * ms),
+                  rtimer_second, defines)
+
+
+def check(c: Config) -> list[str]:
+    """What nd.c would reject at compile time, for the mode of c"""
+    errors = []
+    if c.epoch > EPOCH_TICKS_MAX:
+        errors.append("epoch longer than 0x8000 ticks")
+    if c.rtimer_second // 1000 == 0 or c.beacon == 0:
+        errors.append("rtimer too slow, durations truncate to 0")
+    if c.jitter_max < 1:
+        errors.append("collision offset below 1 tick")
+    if c.mode == "BURST":
+        if c.rx_window_count < 1 or c.window == 0:
+            errors.append("no reception window")
+        elif c.tx_spacing < c.beacon or c.tx_per_window < 1:
+            errors.append("beacon spacing not between a beacon and a window")
+        elif c.listen <= c.beacon:
+            errors.append("listens not longer than a beacon")
+        elif (c.tx_window_count + c.rx_window_count - 1) * c.window + 2 * c.listen > c.epoch:
+            errors.append("listens overlap at the end of the epoch")
+        elif c.tx_window_count * c.tx_per_window + 2 * (c.rx_window_count + 1) + 2 > SCHEDULE_MAX:
+            errors.append("schedule longer than ND_SCHEDULE_MAX")
+    else:
+        if c.tx_window_count < 1:
+            errors.append("epoch shorter than 200 ms")
+        elif not c.beacon < c.listen <= c.window:
+            errors.append("listen not between a beacon and a window")
+        elif 2 + 2 * c.rx_window_count * (1 << define(c.defines, "ADAPTIVE_MAX_LEVEL", 2)) + c.tx_window_count + 1 > SCHEDULE_MAX:
+            errors.append("schedule longer than ND_SCHEDULE_MAX")
+    return errors
+
+
+def check_build(defines=None, rtimer_second=RTIMER_SECOND) -> list[str]:
+    """What nd.c would reject at compile time, all the modes being built in"""
+    defines = dict(defines or {})
+    errors = [f"{mode}: {e}" for mode in ("BURST", "SCATTER") for e in check(config(mode, defines, rtimer_second))]
+    epoch = define(defines, "EPOCH_INTERVAL_RT", rtimer_second)
+    beacon = (rtimer_second * 6) // 10000
+    slot = epoch // define(defines, "SLOTS_PER_EPOCH", 100)
+    if slot // 4 + 2 * beacon > slot:
+        errors.append("slots too short")
+    if (rtimer_second * 35) // 100000 + beacon + 2 * define(defines, "RDV_GUARD", rtimer_second // 1000) > epoch // 2:
+        errors.append("rendezvous guard too long")
+    return sorted(set(errors))
+
+
+def schedule(c: Config):
+    """Beacon offsets and listen intervals of an epoch, without the collision
+    offset, as nd_schedule_compile() lays them out"""
+    if c.mode == "BURST":
+        beacons = [w * c.window + i * c.tx_spacing for w in range(c.tx_window_count) for i in range(c.tx_per_window)]
+        rx_start = c.tx_window_count * c.window
+        listens = [(rx_start + i * c.window, rx_start + i * c.window + c.listen) for i in range(c.rx_window_count)]
+        listens.append((c.epoch - c.listen, c.epoch))
+    else:
+        tx_start = c.rx_window_count * c.window
+        beacons = [0] + [tx_start + i * c.window for i in range(c.tx_window_count)]
+        listens = [(i * c.window, i * c.window + c.listen) for i in range(c.rx_window_count)]
+    return np.array(beacons), np.array(listens)
+
+
+def first_heard(c: Config, phases, from_sender=False) -> np.ndarray:
+    """Ticks until a node hears a neighbour whose epoch starts phases ticks
+    into its own, counted from its own start or, from_sender, from the
+    neighbour's; inf if never, the schedules repeating every epoch. A beacon
+    is heard if it is all inside a listen."""
+    beacons, listens = schedule(c)
+    at = (beacons[None, :] + phases[:, None]) % c.epoch
+    i = np.searchsorted(listens[:, 0], at, side="right") - 1
+    heard = (i >= 0) & (at + c.beacon <= listens[np.maximum(i, 0), 1])
+    t = np.broadcast_to(beacons[None, :], at.shape) if from_sender else at
+    return np.where(heard, t + c.beacon, np.inf).min(axis=1)
+
+
+def predict(c: Config) -> dict:
+    """Duty cycle and discovery of a pair over all phases, one tick apart.
+    The latency is counted from the start of the later node, each way."""
+    beacons, listens = schedule(c)
+    on = len(beacons) * c.beacon + int(np.sum(listens[:, 1] - listens[:, 0]))
+
+    # the later node starts with the other one at phase in its epoch
+    phases = np.arange(c.epoch)
+    hears = first_heard(c, phases)
+    heard = first_heard(c, (c.epoch - phases) % c.epoch, from_sender=True)
+    latency = np.concatenate([hears, heard])
+    latency = latency[np.isfinite(latency)] / c.rtimer_second
+    return {
+        "duty_cycle_pct": 100.0 * on / c.epoch,
+        "p_one_way": float(np.mean(np.isfinite(hears))),
+        "p_mutual": float(np.mean(np.isfinite(hears) & np.isfinite(heard))),
+        "latency_median_s": float(np.median(latency)) if len(latency) else float("nan"),
+        "latency_max_s": float(np.max(latency)) if len(latency) else float("nan"),
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("--modes", nargs="+", choices=["BURST", "SCATTER"], default=["BURST", "SCATTER"])
+    ap.add_argument("-D", "--define", action="append", default=[], help="ND_CONF_NAME=value, repeatable")
+    ap.add_argument("--rtimer-second", type=int, default=RTIMER_SECOND)
+    args = ap.parse_args()
+
+    defines = dict(d.split("=", 1) for d in args.define)
+    for mode in args.modes:
+        c = config(mode, defines, args.rtimer_second)
+        print(f"{mode}: epoch {c.epoch}, windows {c.tx_window_count} tx {c.rx_window_count} rx of {c.window}, "
+              f"{c.tx_per_window} beacons {c.tx_spacing} apart, listen {c.listen}")
+        if check(c):
+            continue
+        p = predict(c)
+        print("  duty cycle {duty_cycle_pct:.3f}%, heard in an epoch {p_one_way:.4f}, both ways {p_mutual:.4f}, "
+              "latency median {latency_median_s:.3f}s max {latency_max_s:.3f}s".format(**p))
+    errors = check_build(defines, args.rtimer_second)
+    for e in errors:
+        print("invalid: " + e)
+    sys.exit(1 if errors else 0)
+
+
+if __name__ == "__main__":
+    main()
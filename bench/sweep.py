@@ -0,0 +1,164 @@
+"""Parameter sweep: builds a firmware variant for every combination of the
+ND parameters given, runs each over the .csc topologies with fixed seeds,
+and reports the Pareto frontier of duty cycle against discovery ratio and
+latency. Variants are first checked with model.py, and the ones nd.c would
+not compile, or predicted to discover too little, are not run.
+
+    python3 sweep.py --modes BURST \\
+        -p ND_CONF_RECEPTION_WINDOW_COUNT_BURST=4,6,8,10 \\
+        -p ND_CONF_TRANSMISSION_DURATION_BURST=328,492,656 \\
+        --topologies ../nd-test-mrm-10n.csc ../nd-test-mrm-50n.csc --seeds 1 2
+
+The parameters are the ND_CONF_* overrides of nd.h and nd.c, passed as
+ND_DEFINES. With the default runner each variant is a sim/nd-sim build.
+With --runner cooja, --build is a shell command that builds the firmware
+for {defines} into {firmware}, e.g.
+    --build 'make -C .. TARGET=sky ND_DEFINES="{defines}" && cp ../app.sky {firmware}'
+"""
+import argparse
+import hashlib
+import itertools
+import os
+import subprocess
+from concurrent.futures import ThreadPoolExecutor
+from glob import glob
+from os.path import abspath, basename, join
+
+import numpy as np
+
+import bench
+import model
+from bench import MODES, ROOT, nd_parser
+
+OUT_FOLDER = join(ROOT, "bench", "sweep")
+
+
+def variants(params, modes):
+    """(mode, ND_DEFINES) of every combination"""
+    names = [p.split("=", 1)[0] for p in params]
+    values = [p.split("=", 1)[1].split(",") for p in params]
+    for mode in modes:
+        for combo in itertools.product(*values):
+            yield mode, [f"{n}={v}" for n, v in zip(names, combo)]
+
+
+def variant_name(mode, defines) -> str:
+    return f"{mode.lower()}-{hashlib.sha1(' '.join(defines).encode()).hexdigest()[:8]}"
+
+
+def build(mode, defines, name, args) -> str:
+    """Sim binary or firmware of a variant"""
+    if args.runner == "sim":
+        return bench.build_sim(mode, defines, name)
+    firmware = abspath(join(args.out, name + ".firmware"))
+    all_defines = " ".join([f"APP_CONF_ND_MODE={MODES[mode]}"] + defines)
+    subprocess.run(args.build.format(defines=all_defines, firmware=firmware), shell=True, check=True)
+    return firmware
+
+
+def run_one(job, args):
+    name, binary, topology, seed = job
+    with open(topology) as f:
+        text = f.read()
+    run_dir = join(args.out, name, f"{basename(topology)[:-4]}_{seed}")
+    os.makedirs(run_dir, exist_ok=True)
+    csc = join(run_dir, "sim.csc")
+    log = run_dir + ".log"
+    firmware = binary if args.runner == "cooja" else None
+    with open(csc, "w") as f:
+        f.write(bench.retarget_csc(text, seed, firmware, int(args.time * 1000)))
+    if args.runner == "sim":
+        bench.run_sim(binary, csc, seed, args, log)
+    else:
+        bench.run_cooja(csc, run_dir, args, log)
+    return log
+
+
+def pareto(points) -> list[bool]:
+    """Points not dominated, each is (duty cycle, -discovery, latency), all
+    to be minimised"""
+    p = np.asarray(points, dtype=float)
+    p = np.where(np.isnan(p), np.inf, p)
+    front = []
+    for i in range(len(p)):
+        dominated = np.any(np.all(p <= p[i], axis=1) & np.any(p < p[i], axis=1))
+        front.append(not dominated)
+    return front
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("-p", "--param", action="append", default=[], help="NAME=v1,v2,... swept, repeatable")
+    ap.add_argument("--modes", nargs="+", choices=sorted(MODES), default=sorted(MODES))
+    ap.add_argument("--topologies", nargs="+", default=sorted(glob(join(ROOT, "nd-test-mrm-*n.csc"))))
+    ap.add_argument("--seeds", type=int, nargs="+", default=[1])
+    ap.add_argument("-t", "--time", type=float, default=200, help="simulated time [s]")
+    ap.add_argument("-r", "--range", type=float, default=400, help="nd-sim transmission range [m]")
+    ap.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    ap.add_argument("--runner", choices=["sim", "cooja"], default="sim")
+    ap.add_argument("--cooja", help="Cooja command line, {csc} is the simulation file")
+    ap.add_argument("--build", help="firmware build command for Cooja, see above")
+    ap.add_argument("--sim-args", nargs=argparse.REMAINDER, default=[], help="more nd-sim options")
+    ap.add_argument("--min-discovery", type=float, default=0.0,
+                    help="skip the variants the model gives a lower discovery probability in an epoch")
+    ap.add_argument("-o", "--out", default=OUT_FOLDER)
+    args = ap.parse_args()
+
+    if args.runner == "cooja" and not (args.cooja and args.build):
+        ap.error("--runner cooja needs --cooja and --build")
+    os.makedirs(args.out, exist_ok=True)
+
+    # the model rejects what would not compile, and what would not discover
+    # enough to be worth simulating
+    todo = []
+    predicted = {}
+    for mode, defines in variants(args.param, args.modes):
+        name = variant_name(mode, defines)
+        errors = model.check_build(dict(d.split("=", 1) for d in defines))
+        p = None if errors else model.predict(model.config(mode, dict(d.split("=", 1) for d in defines)))
+        if errors or p["p_mutual"] < args.min_discovery:
+            print(f"skipped {name} {' '.join(defines)}: " + (", ".join(errors) or f"discovery {p['p_mutual']:.4f}"))
+            continue
+        todo.append((mode, defines, name))
+        predicted[name] = p
+    print(f"{len(todo)} variants x {len(args.topologies)} topologies x {len(args.seeds)} seeds")
+
+    # one build at a time: the sim builds are quick, and firmware builds
+    # usually share the source tree
+    binaries = {name: build(mode, defines, name, args) for mode, defines, name in todo}
+
+    jobs = [(name, binaries[name], t, s) for _, _, name in todo for t in args.topologies for s in args.seeds]
+    with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        logs = list(pool.map(lambda job: run_one(job, args), jobs))
+    exps = nd_parser.parse_all(logs)
+
+    results = []
+    for mode, defines, name in todo:
+        mine = [e for job, e in zip(jobs, exps) if job[0] == name]
+        lat = np.concatenate([e.latency for e in mine])
+        results.append((mode, defines, name,
+                        np.mean([e.dc_mean for e in mine]),
+                        np.mean([e.avg_n_count_epoch_overall_percentage for e in mine]),
+                        np.median(lat) if len(lat) else np.nan,
+                        np.percentile(lat, 90) if len(lat) else np.nan))
+
+    front = pareto([(r[3], -r[4], r[5]) for r in results])
+
+    lines = ["variant,mode,defines,duty_cycle_pct,discovery_ratio,latency_median_s,latency_p90_s,pareto,"
+             "model_duty_cycle_pct,model_discovery,model_latency_median_s"]
+    print("\n{:16s} {:>8s} {:>10s} {:>8s} {:>8s}  {}".format("variant", "dc %", "discovery", "lat p50", "lat p90",
+                                                            "defines"))
+    for r, f in sorted(zip(results, front), key=lambda x: x[0][3]):
+        mode, defines, name, dc, ratio, p50, p90 = r
+        m = predicted[name]
+        lines.append(f"{name},{mode},{' '.join(defines)},{dc:.4f},{ratio:.4f},{p50:.4f},{p90:.4f},{int(f)},"
+                     f"{m['duty_cycle_pct']:.4f},{m['p_mutual']:.4f},{m['latency_median_s']:.4f}")
+        print("{:16s} {:8.3f} {:10.4f} {:8.3f} {:8.3f}  {}{}".format(name, dc, ratio, p50, p90, " ".join(defines),
+                                                                    "  *" if f else ""))
+    with open(join(args.out, "sweep.csv"), "w") as f:
+        f.write("\n".join(lines) + "\n")
+    print(f"\n* Pareto frontier, saved to {join(args.out, 'sweep.csv')}")
+
+
+if __name__ == "__main__":
+    main()
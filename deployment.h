@@ -30,4 +30,9 @@ void deployment_print_id_info(void);
  */
 bool deployment_get_addr_by_id(uint16_t node_id, linkaddr_t *addr);
 
+/* Get the dense index of a node, its position in id order among the nodes of
+ * deployment.csv, or -1 if node_id is not in the table.
+ */
+int16_t deployment_index(uint16_t node_id);
+
 #endif /* DEPLOYMENT_H */
@@ -0,0 +1,198 @@
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+/*---------------------------------------------------------------------------*/
+#include <stdio.h>
+/*---------------------------------------------------------------------------*/
+#include "nd-log.h"
+/*---------------------------------------------------------------------------*/
+#if (ND_LOG_BUF_LEN & (ND_LOG_BUF_LEN - 1)) != 0 || ND_LOG_BUF_LEN > 0x8000
+#error ND_LOG_BUF_LEN must be a power of 2 not larger than 0x8000
+#endif
+#if ND_LOG_LINE_BYTES < 2 + 2 * ND_LOG_VALUES_MAX || ND_LOG_LINE_BYTES > 255
+#error ND_LOG_LINE_BYTES must fit the longest record
+#endif
+
+#define ND_LOG_MASK (ND_LOG_BUF_LEN - 1)
+#define ND_LOG_REC_LEN(n) (2 + 2 * (n)) // type, count and the values
+
+// head and tail run freely, the buffer is indexed with ND_LOG_MASK
+uint8_t log_buf[ND_LOG_BUF_LEN];
+volatile uint16_t log_head = 0; // written by the producers only
+volatile uint16_t log_tail = 0; // written by nd_log_process only
+volatile uint8_t log_busy = 0;  // a producer is writing a record
+// records dropped, counted by the producers and reported by nd_log_process
+// up to log_dropped_acked: only ever incremented, so that the drain never
+// writes a counter the producers update from interrupts
+volatile uint16_t log_dropped = 0;
+uint16_t log_dropped_acked = 0;
+
+#if ND_LOG_TEXT
+// Text of each record type, fed all the values. Signed values are listed
+// in a bit mask.
+struct nd_log_format
+{
+  const char *fmt;
+  uint16_t is_signed;
+};
+
+static const struct nd_log_format nd_log_formats[ND_LOG_TYPES] = {
+    {"ND: log dropped %u\n", 0},
+    {"App: Epoch %u New NBR %u\n", 0},
+    {"App: Epoch %u finished Num NBR %u Num new NBR %u\n", 0},
+    {"App: Epoch %u listen %u target %u level %u candidates %u hits %u\n", 0},
+    {"App: Epoch %u tx %u busy %u collisions %u backoffs %u dropped %u rx dropped %u\n", 0},
+    {"App: Epoch %u radio idle %u %u tx %u %u rx %u %u last %u %u\n", 0},
+    {"NCO: %u\n", 0},
+    {"ND: late epoch %u n %u min %d max %d p99 %u\n", 0x0C},
+    {"ND: trace %u at %u late %d\n", 0x04},
+    {"ND: Epoch %u heard %u at %u %u\n", 0},
+    {"App: Epoch %u hop tx %u rx %u\n", 0},
+};
+#endif
+
+PROCESS(nd_log_process, "ND log process");
+
+/*---------------------------------------------------------------------------*/
+
+void nd_log_write(uint8_t type, const uint16_t *v, uint8_t n)
+{
+  uint16_t head;
+  uint8_t i;
+
+  // an interrupted producer holds the buffer, give up rather than wait
+  if (log_busy)
+  {
+    log_dropped++;
+    return;
+  }
+  log_busy = 1;
+  head = log_head;
+  if (n > ND_LOG_VALUES_MAX || (uint16_t)(ND_LOG_BUF_LEN - (head - log_tail)) < ND_LOG_REC_LEN(n))
+  {
+    log_dropped++;
+    log_busy = 0;
+    return;
+  }
+
+  log_buf[head++ & ND_LOG_MASK] = type;
+  log_buf[head++ & ND_LOG_MASK] = n;
+  for (i = 0; i < n; i++)
+  {
+    log_buf[head++ & ND_LOG_MASK] = v[i] & 0xFF;
+    log_buf[head++ & ND_LOG_MASK] = v[i] >> 8;
+  }
+  log_head = head; // publishes the record
+  log_busy = 0;
+
+  process_poll(&nd_log_process);
+}
+
+/**
+ * Byte of the buffer at the free running index i
+ */
+static uint8_t nd_log_byte(uint16_t i)
+{
+  return log_buf[i & ND_LOG_MASK];
+}
+
+#if ND_LOG_TEXT
+/**
+ * Prints the record at tail as text
+ */
+static void nd_log_print(uint16_t tail)
+{
+  uint8_t type = nd_log_byte(tail);
+  uint8_t n = nd_log_byte(tail + 1);
+  int a[ND_LOG_VALUES_MAX] = {0};
+  uint8_t i;
+
+  if (type >= ND_LOG_TYPES)
+  {
+    return;
+  }
+  for (i = 0; i < n; i++)
+  {
+    uint16_t v = nd_log_byte(tail + 2 + 2 * i) | (nd_log_byte(tail + 3 + 2 * i) << 8);
+    a[i] = (nd_log_formats[type].is_signed & (1u << i)) ? (int)(int16_t)v : (int)v;
+  }
+  printf(nd_log_formats[type].fmt, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+}
+#else
+/**
+ * Prints the records from tail to head as hex, whole records per line
+ */
+static uint16_t nd_log_print_hex(uint16_t tail, uint16_t head)
+{
+  static const char hex[] = "0123456789abcdef";
+  char line[2 * ND_LOG_LINE_BYTES + 1];
+  uint8_t len = 0;
+
+  while (tail != head)
+  {
+    uint8_t rec = ND_LOG_REC_LEN(nd_log_byte(tail + 1));
+    uint8_t i;
+
+    if (len != 0 && len + rec > ND_LOG_LINE_BYTES)
+    {
+      break;
+    }
+    for (i = 0; i < rec; i++, len++)
+    {
+      line[2 * len] = hex[nd_log_byte(tail + i) >> 4];
+      line[2 * len + 1] = hex[nd_log_byte(tail + i) & 0x0F];
+    }
+    tail += rec;
+  }
+  line[2 * len] = '\0';
+  printf("NDL:%s\n", line);
+  return tail;
+}
+#endif
+
+/**
+ * Prints all the queued records
+ */
+static void nd_log_drain(void)
+{
+  uint16_t head = log_head;
+  uint16_t tail = log_tail;
+  uint16_t dropped;
+
+  while (tail != head)
+  {
+#if ND_LOG_TEXT
+    nd_log_print(tail);
+    tail += ND_LOG_REC_LEN(nd_log_byte(tail + 1));
+#else
+    tail = nd_log_print_hex(tail, head);
+#endif
+    log_tail = tail; // frees the space
+  }
+
+  dropped = log_dropped - log_dropped_acked;
+  if (dropped != 0)
+  {
+    log_dropped_acked += dropped;
+    nd_log_write(ND_LOG_DROPPED, &dropped, 1);
+  }
+}
+
+void nd_log_init(void)
+{
+  process_start(&nd_log_process, NULL);
+}
+
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nd_log_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while (1)
+  {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    nd_log_drain();
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,68 @@
+/*---------------------------------------------------------------------------*/
+#ifndef ND_LOG_H
+#define ND_LOG_H
+
+#include "contiki.h"
+
+/*---------------------------------------------------------------------------*/
+/* Deferred logging: the ND and application events produced in rtimer and
+ * radio context are stored as compact records in a RAM ring buffer, and
+ * printed later by nd_log_process. A record is its type, the number of
+ * values and the values, 16 bits little endian each.
+ *
+ * By default records are printed in batches as hex, one "NDL:<hex>" line
+ * for up to ND_LOG_LINE_BYTES bytes, which parser/parser.py decodes. With
+ * ND_CONF_LOG_TEXT set to 1 they are printed as the usual text lines. */
+#ifdef ND_CONF_LOG_TEXT
+#define ND_LOG_TEXT ND_CONF_LOG_TEXT
+#else
+#define ND_LOG_TEXT 0
+#endif
+
+/* Size of the ring buffer [bytes], a power of 2 */
+#ifdef ND_CONF_LOG_BUF_LEN
+#define ND_LOG_BUF_LEN ND_CONF_LOG_BUF_LEN
+#else
+#define ND_LOG_BUF_LEN 256
+#endif
+
+#ifdef ND_CONF_LOG_LINE_BYTES
+#define ND_LOG_LINE_BYTES ND_CONF_LOG_LINE_BYTES
+#else
+#define ND_LOG_LINE_BYTES 32
+#endif
+
+#define ND_LOG_VALUES_MAX 9
+
+/* Record types, keep in sync with ND_LOG_FORMATS in parser/parser.py */
+#define ND_LOG_DROPPED 0   /* records lost, buffer full */
+#define ND_LOG_NEW_NBR 1   /* epoch, neighbor id */
+#define ND_LOG_EPOCH_END 2 /* epoch, neighbors, new neighbors */
+#define ND_LOG_LISTEN 3    /* epoch, listen, target, level, candidates, hits */
+#define ND_LOG_TX 4        /* epoch, sent, busy, collisions, backoffs, dropped,
+                              rx dropped */
+#define ND_LOG_RADIO 5     /* epoch, tx and rx ticks of each ND_PHASE_* */
+#define ND_LOG_NCO 6       /* collision offset of the epoch */
+#define ND_LOG_LATE 7      /* epoch, actions, min, max and p99 lateness */
+#define ND_LOG_TRACE 8     /* event, due tick, lateness */
+#define ND_LOG_HEARD 9     /* epoch, neighbor id, first heard tick since
+                              nd_start(), low and high half */
+#define ND_LOG_HOP 10      /* epoch, tx channel, rx channel */
+#define ND_LOG_TYPES 11
+/*---------------------------------------------------------------------------*/
+PROCESS_NAME(nd_log_process);
+
+/**
+ * Starts nd_log_process, once
+ */
+void nd_log_init(void);
+
+/**
+ * Queues a record of n values, safe from rtimer and radio context. The
+ * record is dropped and counted if the buffer is full or in use by the
+ * context that was interrupted.
+ */
+void nd_log_write(uint8_t type, const uint16_t *v, uint8_t n);
+
+#endif /* ND_LOG_H */
+/*---------------------------------------------------------------------------*/
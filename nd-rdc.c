@@ -38,19 +38,190 @@
 #include "net/mac/mac.h"
 #include "net/mac/rdc.h"
 #include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "lib/random.h"
 #include <stdio.h>
+#include <string.h>
 #include "nd.h"
+#include "nd-rdc.h"
+
+// as in nd.c, checked at the int width of the target
+ND_STATIC_ASSERT(ND_RDC_BACKOFF_UNIT != 0, rdc_backoff_unit_truncates_to_0);
+ND_STATIC_ASSERT(ND_RDC_CCA_TICKS != 0, rdc_cca_ticks_truncate_to_0);
+
+static struct nd_rdc_stats stats;
+static uint8_t phase = ND_PHASE_IDLE;
+static uint8_t radio_on = 0;
+static rtimer_clock_t radio_on_at; // start of the listening not charged yet
+// frame in the radio's TX buffer, sent again without a prepare() while the
+// beacon is unchanged. NULL if it is not known.
+static const void *staged = NULL;
+static unsigned short staged_len = 0;
+
+/*---------------------------------------------------------------------------*/
+static void
+charge_rx(void)
+{
+  rtimer_clock_t now = RTIMER_NOW();
+
+  if (radio_on)
+  {
+    stats.rx_ticks[phase] += now - radio_on_at;
+  }
+  radio_on_at = now;
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+charge_cca(void)
+{
+  // the radio turns the receiver on for the assessment and off again, the
+  // time is already charged while listening
+  if (!radio_on)
+  {
+    stats.rx_ticks[phase] += ND_RDC_CCA_TICKS;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+static int
+cca(void)
+{
+  charge_cca();
+  if (NETSTACK_RADIO.channel_clear())
+  {
+    return 1;
+  }
+  stats.busy++;
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+static int
+transmit(const void *payload, unsigned short len)
+{
+  int ret;
+
+  if (!cca())
+  {
+    return MAC_TX_COLLISION;
+  }
+  // the cc2420 and cc2538 keep the TX FIFO across transmissions and radio
+  // off (the zoul stays in PM0, see project-conf.h), only a new frame is
+  // written to it
+  if (payload != staged || len != staged_len)
+  {
+    staged = NULL;
+    if (NETSTACK_RADIO.prepare(payload, len) != 0)
+    {
+      return MAC_TX_ERR;
+    }
+    staged = payload;
+    staged_len = len;
+  }
+  charge_cca(); // the radio's own, before the frame
+  ret = NETSTACK_RADIO.transmit(len);
+  if (ret == RADIO_TX_COLLISION)
+  {
+    // the radio found the channel busy in its own CCA
+    stats.collisions++;
+    return MAC_TX_COLLISION;
+  }
+  if (ret != RADIO_TX_OK)
+  {
+    return MAC_TX_ERR;
+  }
+  stats.sent++;
+  stats.tx_ticks[phase] += ND_RDC_AIRTIME(len);
+  return MAC_TX_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+int
+nd_rdc_send_beacon(const void *payload, unsigned short len, uint8_t attempt,
+                   rtimer_clock_t window_left, rtimer_clock_t *backoff)
+{
+  rtimer_clock_t units;
+
+  switch (transmit(payload, len))
+  {
+  case MAC_TX_OK:
+    return ND_RDC_TX_OK;
+  case MAC_TX_COLLISION:
+    break;
+  default:
+    // the radio could not take or send the frame, only the channel is
+    // worth a retry
+    stats.dropped++;
+    return ND_RDC_TX_DROPPED;
+  }
+  if (attempt >= ND_RDC_MAX_ATTEMPTS)
+  {
+    stats.dropped++;
+    return ND_RDC_TX_DROPPED;
+  }
+
+  // binary exponential backoff, 1 to 2^attempt - 1 units
+  units = 1 + random_rand() % ((1u << attempt) - 1);
+  *backoff = units * ND_RDC_BACKOFF_UNIT;
+  if (*backoff >= window_left)
+  {
+    stats.dropped++;
+    return ND_RDC_TX_DROPPED;
+  }
+  stats.backoffs++;
+  return ND_RDC_TX_DEFER;
+}
+
+/*---------------------------------------------------------------------------*/
+void
+nd_rdc_beacon_changed(void)
+{
+  staged = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+void
+nd_rdc_set_phase(uint8_t p)
+{
+  if (p != phase)
+  {
+    charge_rx();
+    phase = p;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void
+nd_rdc_stats_reset(struct nd_rdc_stats *out)
+{
+  charge_rx();
+  *out = stats;
+  memset(&stats, 0, sizeof(stats));
+}
 
 /*---------------------------------------------------------------------------*/
 static void
 send(mac_callback_t sent, void *ptr)
 {
+  int ret;
+
+  staged = NULL; // packetbuf is reused for every packet
+  ret = transmit(packetbuf_dataptr(), packetbuf_datalen());
+
+  mac_call_sent_callback(sent, ptr, ret, 1);
 }
 
 /*---------------------------------------------------------------------------*/
 static void
 send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *list)
 {
+  if (list != NULL)
+  {
+    queuebuf_to_packetbuf(list->buf);
+    send(sent, ptr);
+  }
 }
 
 /*---------------------------------------------------------------------------*/
@@ -64,21 +235,35 @@ input(void)
 static int
 on(void)
 {
-  NETSTACK_RADIO.on();
-  return 1;
+  if (!radio_on)
+  {
+    charge_rx();
+    radio_on = 1;
+  }
+  return NETSTACK_RADIO.on();
 }
 
 /*---------------------------------------------------------------------------*/
 static int
 off(int keep_radio_on)
 {
-  return keep_radio_on;
+  if (keep_radio_on)
+  {
+    return on();
+  }
+  if (radio_on)
+  {
+    charge_rx();
+    radio_on = 0;
+  }
+  return NETSTACK_RADIO.off();
 }
 
 /*---------------------------------------------------------------------------*/
 static unsigned short
-cca(void)
+channel_check_interval(void)
 {
+  // nd.c runs its own listening schedule, there is no periodic check
   return 0;
 }
 
@@ -86,6 +271,9 @@ cca(void)
 static void
 init(void)
 {
+  memset(&stats, 0, sizeof(stats));
+  phase = ND_PHASE_IDLE;
+  staged = NULL;
   on();
 }
 
@@ -98,6 +286,6 @@ const struct rdc_driver nd_rdc_driver = {
     input,
     on,
     off,
-    cca,
+    channel_check_interval,
 };
 /*---------------------------------------------------------------------------*/
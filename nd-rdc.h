@@ -0,0 +1,88 @@
+/*---------------------------------------------------------------------------*/
+#ifndef ND_RDC_H
+#define ND_RDC_H
+
+#include "contiki.h"
+#include "net/mac/rdc.h"
+#include "nd.h"
+
+/*---------------------------------------------------------------------------*/
+/* Channel access for beacons: a beacon is sent only after a clear channel
+ * assessment. When the channel is busy it is deferred by a random backoff of
+ * 1 to 2^attempt - 1 beacon airtimes, up to ND_RDC_MAX_ATTEMPTS attempts,
+ * and dropped if the backoff does not fit in what is left of its window */
+#ifdef ND_RDC_CONF_MAX_ATTEMPTS
+#define ND_RDC_MAX_ATTEMPTS ND_RDC_CONF_MAX_ATTEMPTS
+#else
+#define ND_RDC_MAX_ATTEMPTS 4
+#endif
+
+/* Backoff unit [rtimer ticks], one beacon airtime by default */
+#ifdef ND_RDC_CONF_BACKOFF_UNIT
+#define ND_RDC_BACKOFF_UNIT ND_RDC_CONF_BACKOFF_UNIT
+#else
+#define ND_RDC_BACKOFF_UNIT ((uint32_t)RTIMER_SECOND * 6 / 10000)
+#endif
+
+/* Results of nd_rdc_send_beacon() */
+#define ND_RDC_TX_OK 0
+#define ND_RDC_TX_DEFER 1   /* channel busy, try again after the backoff */
+#define ND_RDC_TX_DROPPED 2 /* no attempts or time left for the beacon, or
+                             * the radio failed to send it */
+
+/* Radio time of a clear channel assessment with the radio off [rtimer
+ * ticks]: receiver calibration and 8 symbol periods, ~0.32 ms */
+#ifdef ND_RDC_CONF_CCA_TICKS
+#define ND_RDC_CCA_TICKS ND_RDC_CONF_CCA_TICKS
+#else
+#define ND_RDC_CCA_TICKS ((uint32_t)RTIMER_SECOND * 32 / 100000)
+#endif
+
+/* Airtime of a beacon of len bytes: preamble, SFD, length and FCS on top of
+ * the payload, 32 us per byte at 250 kbps [rtimer ticks] */
+#define ND_RDC_AIRTIME(len) ((rtimer_clock_t)((((uint32_t)(len) + 8) * RTIMER_SECOND) / 31250))
+
+/* Channel access counters and radio time per ND_PHASE_*, since the last
+ * nd_rdc_stats_reset() */
+struct nd_rdc_stats
+{
+  uint16_t sent;       /* beacons on the air */
+  uint16_t busy;       /* clear channel assessments that failed */
+  uint16_t collisions; /* transmissions aborted by the radio's own CCA */
+  uint16_t backoffs;   /* beacons deferred */
+  uint16_t dropped;    /* beacons given up or failed in the radio */
+  uint16_t tx_ticks[ND_PHASES]; /* airtime of the beacons sent */
+  uint16_t rx_ticks[ND_PHASES]; /* radio on, listening or assessing the channel */
+};
+/*---------------------------------------------------------------------------*/
+extern const struct rdc_driver nd_rdc_driver;
+
+/**
+ * Sends a beacon if the channel is clear. attempt counts from 1, window_left
+ * is the time left to send it [rtimer ticks]. On ND_RDC_TX_DEFER, *backoff
+ * tells when to call again for the next attempt.
+ * The frame is written to the radio only when payload or len differ from
+ * the previous beacon, otherwise the radio sends it again as it is.
+ */
+int nd_rdc_send_beacon(const void *payload, unsigned short len, uint8_t attempt,
+                       rtimer_clock_t window_left, rtimer_clock_t *backoff);
+
+/**
+ * Tells that the content of the last beacon payload changed, so that the
+ * next nd_rdc_send_beacon() writes it to the radio again
+ */
+void nd_rdc_beacon_changed(void);
+
+/**
+ * Charges the radio time from now on to phase, one of ND_PHASE_*
+ */
+void nd_rdc_set_phase(uint8_t phase);
+
+/**
+ * Copies the counters into stats and clears them, a listen in progress is
+ * charged up to now
+ */
+void nd_rdc_stats_reset(struct nd_rdc_stats *stats);
+
+#endif /* ND_RDC_H */
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,135 @@
+/*---------------------------------------------------------------------------*/
+#include "contiki.h"
+#include "sys/rtimer.h"
+/*---------------------------------------------------------------------------*/
+#include <string.h>
+/*---------------------------------------------------------------------------*/
+#include "nd-trace.h"
+#include "nd-log.h"
+/*---------------------------------------------------------------------------*/
+#if ND_TRACE
+
+#if (ND_TRACE_LEN & (ND_TRACE_LEN - 1)) != 0 || ND_TRACE_LEN > 256
+#error ND_TRACE_LEN must be a power of 2 not larger than 256
+#endif
+
+#define ND_TRACE_MASK (ND_TRACE_LEN - 1)
+#define ND_TRACE_LATE_MAX 0x7FFF // lateness is saturated to this [ticks]
+#define ND_TRACE_BUCKETS 16      // bucket i holds lateness below 2^i, over 2^(i-1)
+
+struct nd_trace_entry
+{
+  uint8_t event;
+  rtimer_clock_t at;  // tick the event was due at
+  rtimer_clock_t now; // tick it ran at
+};
+
+struct nd_trace_entry trace[ND_TRACE_LEN];
+uint8_t trace_pos = 0; // next record to write
+uint16_t trace_n = 0;  // records in this epoch
+int16_t trace_min = 0;
+int16_t trace_max = 0;
+uint16_t trace_hist[ND_TRACE_BUCKETS];
+
+/*---------------------------------------------------------------------------*/
+
+/**
+ * Lateness of a record, negative if it ran early [ticks]
+ */
+static int16_t nd_trace_late(const struct nd_trace_entry *e)
+{
+  rtimer_clock_t d;
+
+  if (RTIMER_CLOCK_LT(e->now, e->at))
+  {
+    d = e->at - e->now;
+    return d > ND_TRACE_LATE_MAX ? -ND_TRACE_LATE_MAX : -(int16_t)d;
+  }
+  d = e->now - e->at;
+  return d > ND_TRACE_LATE_MAX ? ND_TRACE_LATE_MAX : (int16_t)d;
+}
+
+/**
+ * Histogram bucket of a lateness, its number of significant bits
+ */
+static uint8_t nd_trace_bucket(int16_t late)
+{
+  uint8_t b = 0;
+
+  while (late > 0 && b < ND_TRACE_BUCKETS - 1)
+  {
+    late >>= 1;
+    b++;
+  }
+  return b;
+}
+
+void nd_trace_record(uint8_t event, rtimer_clock_t at)
+{
+  struct nd_trace_entry *e = &trace[trace_pos];
+  int16_t late;
+
+  e->event = event;
+  e->at = at;
+  e->now = RTIMER_NOW();
+  trace_pos = (trace_pos + 1) & ND_TRACE_MASK;
+
+  late = nd_trace_late(e);
+  if (trace_n == 0 || late < trace_min)
+  {
+    trace_min = late;
+  }
+  if (trace_n == 0 || late > trace_max)
+  {
+    trace_max = late;
+  }
+  trace_hist[nd_trace_bucket(late)]++;
+  if (trace_n != 0xFFFF)
+  {
+    trace_n++;
+  }
+}
+
+void nd_trace_flush(uint16_t epoch)
+{
+  uint16_t rank = trace_n - trace_n / 100; // records at or below the p99
+  uint16_t sum = 0;
+  uint8_t b;
+  uint8_t i;
+
+  if (trace_n == 0)
+  {
+    return;
+  }
+  for (b = 0; b < ND_TRACE_BUCKETS - 1; b++)
+  {
+    sum += trace_hist[b];
+    if (sum >= rank)
+    {
+      break;
+    }
+  }
+  // the p99 is given as the upper bound of its bucket
+  uint16_t late[] = {epoch, trace_n, trace_min, trace_max, (1u << b) - 1};
+  nd_log_write(ND_LOG_LATE, late, 5);
+
+  if (trace_max > (int16_t)ND_TRACE_DUMP_LATE)
+  {
+    // oldest record first
+    for (i = 0; i < ND_TRACE_LEN; i++)
+    {
+      const struct nd_trace_entry *e = &trace[(trace_pos + i) & ND_TRACE_MASK];
+      if (e->at != 0 || e->now != 0)
+      {
+        uint16_t rec[] = {e->event, e->at, nd_trace_late(e)};
+        nd_log_write(ND_LOG_TRACE, rec, 3);
+      }
+    }
+  }
+
+  trace_n = 0;
+  memset(trace_hist, 0, sizeof(trace_hist));
+}
+
+#endif /* ND_TRACE */
+/*---------------------------------------------------------------------------*/
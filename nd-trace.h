@@ -0,0 +1,58 @@
+/*---------------------------------------------------------------------------*/
+#ifndef ND_TRACE_H
+#define ND_TRACE_H
+
+#include "contiki.h"
+
+/*---------------------------------------------------------------------------*/
+/* Lateness trace of the schedule: every action run by nd.c is recorded with
+ * the tick it was due at and the tick it actually ran at. The last
+ * ND_TRACE_LEN records are kept in a ring buffer, and a log2 histogram of
+ * the lateness gives min/max/p99 at each epoch end. Set ND_CONF_TRACE to 0
+ * to compile it out. */
+#ifdef ND_CONF_TRACE
+#define ND_TRACE ND_CONF_TRACE
+#else
+#define ND_TRACE 1
+#endif
+
+/* Records kept, a power of 2 */
+#ifdef ND_CONF_TRACE_LEN
+#define ND_TRACE_LEN ND_CONF_TRACE_LEN
+#else
+#define ND_TRACE_LEN 16
+#endif
+
+/* The ring buffer is logged at the epoch end when an action was later than
+ * this [rtimer ticks], ~1 ms by default */
+#ifdef ND_CONF_TRACE_DUMP_LATE
+#define ND_TRACE_DUMP_LATE ND_CONF_TRACE_DUMP_LATE
+#else
+#define ND_TRACE_DUMP_LATE (RTIMER_SECOND / 1000)
+#endif
+
+/* Events besides the schedule actions, which are recorded as themselves */
+#define ND_TRACE_RDV 0x10   /* rendezvous listen opened or closed */
+#define ND_TRACE_RETRY 0x11 /* beacon sent again after a backoff */
+/*---------------------------------------------------------------------------*/
+#if ND_TRACE
+/**
+ * Records that event, due at the tick at, runs now
+ */
+void nd_trace_record(uint8_t event, rtimer_clock_t at);
+
+/**
+ * Logs the lateness summary of the epoch, and the ring buffer if it was
+ * over ND_TRACE_DUMP_LATE, then starts a new epoch
+ */
+void nd_trace_flush(uint16_t epoch);
+
+#define ND_TRACE_RECORD(event, at) nd_trace_record(event, at)
+#define ND_TRACE_FLUSH(epoch) nd_trace_flush(epoch)
+#else
+#define ND_TRACE_RECORD(event, at)
+#define ND_TRACE_FLUSH(epoch)
+#endif
+
+#endif /* ND_TRACE_H */
+/*---------------------------------------------------------------------------*/
@@ -9,8 +9,15 @@
 /*---------------------------------------------------------------------------*/
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 /*---------------------------------------------------------------------------*/
 #include "nd.h"
+#include "nd-rdc.h"
+#include "nd-trace.h"
+#include "nd-log.h"
+#if CONTIKI_TARGET_ZOUL
+#include "deployment.h"
+#endif
 /*---------------------------------------------------------------------------*/
 #define DEBUG 0
 #if DEBUG
@@ -23,10 +30,20 @@ struct nd_callbacks app_cb = {
     .nd_new_nbr = NULL,
     .nd_epoch_end = NULL};
 
+#define ND_DIGEST_BITS 64 // ids in a digest slice
+
+#define ND_BEACON_HDR_LEN (sizeof(uint32_t) + sizeof(uint16_t)) // id and offset
+
+// Beacon: the node id, optionally followed by the offset of the beacon from
+// the sender's epoch start (0xFFFF if not sent) and by a digest of the
+// sender's neighbours. The digest is the bitmap of the known ids in a slice
+// of ND_DIGEST_BITS ids, a different slice every epoch.
 struct beacon_msg
 {
-  uint16_t epoch;
-  uint8_t id;
+  uint32_t nid;
+  uint16_t offset;
+  uint16_t slice;
+  uint8_t digest[ND_DIGEST_BITS / 8];
 } __attribute__((packed));
 
 int TRANSMISSION_PER_WINDOW = 0;
@@ -38,37 +55,200 @@ int RECEPTION_DURATION = 0;
 int TRANSMISSION_WINDOW_DURATION = 0;
 int RECEPTION_WINDOW_DURATION = 0;
 bool FIRST_TRANSMIT = false; // basically tells if to use BURST or SCATTER
+rtimer_clock_t epoch_duration = 0; // period of the schedule, one slot in the slotted modes
+uint8_t nd_mode = 0;
+
+// slotted modes: the epoch is made of slots_per_epoch slots, only some of
+// them awake. The counters follow the slot number modulo the mode periods.
+uint8_t slots_per_epoch = 0;
+uint8_t epoch_slot = 0;
+bool slot_awake = false;
+uint16_t slot_c1 = 0;
+uint16_t slot_c2 = 0;
+
+// adaptive listening: only one reception window every 2^listen_level is
+// opened, rotating with the epoch. The level goes up after
+// ND_ADAPTIVE_QUIET_EPOCHS epochs without new neighbours and back to 0 as
+// soon as a new or a returning neighbour is heard.
+bool adaptive = false;
+uint8_t listen_level = 0;
+uint8_t quiet_epochs = 0;
+bool table_rx = false; // the schedule wants the radio on
+bool radio_rx = false;
+rtimer_clock_t rx_on_at = 0;
+uint16_t listen_ticks = 0; // listening time in this epoch [ticks]
+uint16_t listen_full = 0;  // listening time of the schedule at level 0 [ticks]
+
+// gossip: ids advertised by neighbours and not known yet are candidates,
+// likely in range. A new candidate gives ND_GOSSIP_BOOST_EPOCHS epochs of
+// extra listening. Entries are kept ND_GOSSIP_RETRY epochs, so that a
+// candidate out of range does not boost again at every beacon.
+struct nd_candidate
+{
+  uint16_t id;    // 0 if free
+  uint16_t since; // epoch it was first advertised
+};
+
+bool gossip = false;
+struct nd_candidate candidates[ND_GOSSIP_CANDIDATES];
+uint8_t gossip_boost = 0; // epochs of extra listening left
+uint8_t gossip_hits = 0;  // candidates discovered in this epoch
+uint16_t slot_c3 = 0;     // slot number modulo ND_GOSSIP_STRIDE
+
+// rendezvous: beacons carry the offset from the sender's epoch start, so the
+// start of each neighbour's epoch is known within ours (nd_nbr.phase). Every
+// epoch a short listen is planned around it, merged with the schedule, while
+// the blind reception windows back off as in adaptive listening.
+struct nd_rdv
+{
+  rtimer_clock_t on;
+  rtimer_clock_t off;
+};
+
+bool rendezvous = false;
+uint8_t rendezvous_n = 0; // listens planned in this epoch
+struct nd_rdv rdv[ND_RDV_MAX];
+uint8_t rdv_len = 0;
+uint8_t rdv_pos = 0; // next action, 2 * i to open rdv[i] and 2 * i + 1 to close it
+bool rdv_rx = false; // a rendezvous wants the radio on
+
+// what the rtimer side reads of the neighbour table. nd_process inserts
+// into and shifts the table at any time, so it fills the copy not
+// published and publishes it with a single write, as rx_head publishes a
+// beacon. The rtimer preempts nd_process but never the other way round, so
+// the published copy is not written while it is read.
+struct nd_rdv_nbr
+{
+  uint16_t phase;       // as in nd_nbr
+  uint16_t phase_epoch;
+  int16_t drift;
+  uint16_t last_seen;
+};
+
+struct nd_nbr_view
+{
+  uint16_t slice; // gossip digest
+  uint8_t digest[ND_DIGEST_BITS / 8];
+  uint8_t rdv_len; // rendezvous candidates
+  struct nd_rdv_nbr rdv[ND_RDV_MAX];
+};
+
+struct nd_nbr_view nbr_view[2];
+volatile uint8_t nbr_view_pub = 0; // copy read by the rtimer side
+uint16_t digest_slice = 0xFFFF;    // slice advertised from the next epoch
+
+// channel hopping: the beacons of an epoch go out on one channel of the set
+// and the listens of the epoch are on another, both derived from the epoch
+// counters and the node id, see nd_hop_next()
+static const uint8_t hop_channels[] = ND_HOP_CHANNELS;
+#define ND_HOP_CHANNEL_COUNT (sizeof(hop_channels) / sizeof(hop_channels[0]))
+
+bool hop = false;
+uint8_t hop_c = 0;     // epoch number modulo the channel count
+uint8_t hop_round = 0; // round of the channels modulo the channel count
+uint8_t hop_tx_channel = 0;
+uint8_t hop_rx_channel = 0;
+uint8_t hop_channel = 0; // channel the radio is set to, 0 if not set yet
 
-uint8_t sent_beacon_count = 0;
-int listen_count = 0;
 uint16_t epoch = 0;
 uint8_t discovered_n_epoch = 0; // number of all neighbours discovered each epoch
 uint8_t discovered_n_epoch_new = 0; // number of new nodes discovered each epoch
-unsigned short epoch_start = 0;
-int transmit_window_count = 0;
-bool collision = true;
+
+// Beacons are queued by nd_recv() in the radio input path and applied to the
+// neighbour table by nd_process, which also runs the application callbacks.
+// nd_recv() is the only producer and nd_process the only consumer, each one
+// writes its own index. The table and the discovery counters above belong to
+// nd_process and are at nbr_epoch, which follows epoch once nd_process has
+// ended it.
+struct nd_rx_event
+{
+  uint16_t epoch;  // epoch the beacon was heard in
+  uint16_t phase;  // start of the sender's epoch in ours, 0xFFFF if unknown
+  int8_t rssi;
+  uint8_t lqi;
+  uint8_t len;     // bytes of msg received
+#if ND_LATENCY
+  uint32_t heard;  // start of frame, ticks since nd_start()
+#endif
+  struct beacon_msg msg;
+};
+
+#if (ND_RX_QUEUE_LEN & (ND_RX_QUEUE_LEN - 1)) != 0 || ND_RX_QUEUE_LEN > 128
+#error ND_RX_QUEUE_LEN must be a power of 2 not larger than 128
+#endif
+
+#define ND_RX_QUEUE_MASK (ND_RX_QUEUE_LEN - 1)
+
+struct nd_rx_event rx_queue[ND_RX_QUEUE_LEN];
+volatile uint8_t rx_head = 0; // next event written by nd_recv()
+volatile uint8_t rx_tail = 0; // next event read by nd_process
+uint16_t rx_dropped = 0;      // beacons lost with the queue full, this epoch
+uint16_t nbr_epoch = 0;
+
+// the figures of the rtimer side of an epoch, reported by nd_process; two
+// slots so that an epoch can end before the previous one is reported
+struct nd_epoch_stats epoch_stats[2];
+uint16_t epoch_stats_epoch[2];
+// start of the current epoch on a 32 bit extension of the rtimer clock:
+// it only ever advances by whole epochs, so the low bits follow the rtimer
+// across its wraps on 16 bit targets and nothing is truncated on 32 bit ones
+uint32_t epoch_start = 0;
+uint32_t start_tick = 0; // epoch_start of the first epoch
 unsigned short collision_offset = 0;
+rtimer_clock_t jitter_max = 1; // collision offsets are below this [ticks]
+uint8_t tx_attempt = 0;          // attempt of the pending beacon, 0 if none
+rtimer_clock_t tx_retry_at = 0;  // offset of its next attempt
+rtimer_clock_t tx_deadline = 0;  // offset it has to be sent by
+
+struct beacon_msg beacon;
+uint8_t beacon_len = sizeof(uint32_t);
+
+#if (MAX_NBR & (MAX_NBR - 1)) != 0 || MAX_NBR > 128
+#error MAX_NBR must be a power of 2 not larger than 128
+#endif
+
+#define ND_NBR_MASK (MAX_NBR - 1)
+
+#if ND_ADAPTIVE_MAX_LEVEL > 4
+#error ND_ADAPTIVE_MAX_LEVEL must not be larger than 4
+#endif
 
-uint32_t nid;
+#if ND_SLOTS_PER_EPOCH < 1 || ND_SLOTS_PER_EPOCH > 255
+#error ND_SLOTS_PER_EPOCH must be between 1 and 255
+#endif
 
-bool neighbors[MAX_NBR]; // assume ids are from 0 to MAX_NBR
-bool neighbors_act_epoch[MAX_NBR]; // assume ids are from 0 to MAX_NBR
+// neighbour records, indexed by open addressing on the node id:
+// a slot is free when its id is 0 (0 is never a valid node id).
+// A neighbour was heard in the current epoch iff last_seen == epoch.
+struct nd_nbr nbr_table[MAX_NBR];
+uint8_t nbr_count = 0;
 
 #define EPOCH_DURATION EPOCH_INTERVAL_RT
-#define NUM_EPOCH_EACH_WRAP EPOCH_DURATION / USHRT_MAX // short unsigned dimension
-#define TICKS_PER_SEC RTIMER_SECOND                    // number of ticks in one second
-#define TICKS_PER_MILLISEC (TICKS_PER_SEC / 1000)      // number of ticks in one millisecond
+#define TICKS_PER_SEC RTIMER_SECOND               // number of ticks in one second
+#define TICKS_PER_MILLISEC (TICKS_PER_SEC / 1000) // number of ticks in one millisecond
+
+// rtimer tick of an offset in the current epoch, and the other way round
+#define EPOCH_TICK(offset) ((rtimer_clock_t)(epoch_start + (offset)))
+#define EPOCH_OFFSET(tick) ((rtimer_clock_t)((tick) - (rtimer_clock_t)epoch_start))
 
+// The parameters below can be overridden with ND_CONF_<name>, see the
+// Makefile's ND_DEFINES. bench/model.py derives the same configuration,
+// keep the two in sync.
 #define TRANSMISSION_WINDOW_COUNT_BURST 1
+#ifdef ND_CONF_RECEPTION_WINDOW_COUNT_BURST
+#define RECEPTION_WINDOW_COUNT_BURST ND_CONF_RECEPTION_WINDOW_COUNT_BURST
+#else
 #define RECEPTION_WINDOW_COUNT_BURST 10
+#endif
 
 #define RECEPTION_WINDOW_COUNT_SCATTER 1
 // basically finds the number of transmission windows which last 100ms that can fit an epoch.
-#define TRANSMISSION_WINDOW_COUNT_SCATTER (((EPOCH_DURATION / TICKS_PER_SEC) * 1000) / 100) - RECEPTION_WINDOW_COUNT_SCATTER
+// The product is computed in 32 bits, it would wrap the 16 bit int of sky.
+#define TRANSMISSION_WINDOW_COUNT_SCATTER ((uint16_t)((uint32_t)EPOCH_DURATION * 10 / TICKS_PER_SEC) - RECEPTION_WINDOW_COUNT_SCATTER)
 
 // both transmission and reception have the same window dimension
-#define WINDOW_LEN_BURST EPOCH_DURATION / (TRANSMISSION_WINDOW_COUNT_BURST + RECEPTION_WINDOW_COUNT_BURST)
-#define WINDOW_LEN_SCATTER EPOCH_DURATION / (TRANSMISSION_WINDOW_COUNT_SCATTER + RECEPTION_WINDOW_COUNT_SCATTER)
+#define WINDOW_LEN_BURST (EPOCH_DURATION / (TRANSMISSION_WINDOW_COUNT_BURST + RECEPTION_WINDOW_COUNT_BURST))
+#define WINDOW_LEN_SCATTER (EPOCH_DURATION / (TRANSMISSION_WINDOW_COUNT_SCATTER + RECEPTION_WINDOW_COUNT_SCATTER))
 
 #define TRANSMISSION_WINDOW_DURATION_BURST WINDOW_LEN_BURST
 #define TRANSMISSION_WINDOW_DURATION_SCATTER WINDOW_LEN_SCATTER
@@ -76,376 +256,1582 @@ bool neighbors_act_epoch[MAX_NBR]; // assume ids are from 0 to MAX_NBR
 #define RECEPTION_WINDOW_DURATION_BURST WINDOW_LEN_BURST
 #define RECEPTION_WINDOW_DURATION_SCATTER WINDOW_LEN_SCATTER
 
+#ifdef ND_CONF_TRANSMISSION_DURATION_BURST
+#define TRANSMISSION_DURATION_BURST ND_CONF_TRANSMISSION_DURATION_BURST // [ticks]
+#else
 #define TRANSMISSION_DURATION_BURST (15 * TICKS_PER_MILLISEC)        // 15ms [ticks]
-#define RECEPTION_DURATION_BURST RECEPTION_WINDOW_DURATION_BURST / 4 // [ticks]
+#endif
+#define RECEPTION_DURATION_BURST (RECEPTION_WINDOW_DURATION_BURST / 4) // [ticks]
 
-#define TRANSMISSION_DURATION_SCATTER 100 * TICKS_PER_MILLISEC            // [ticks]
-#define RECEPTION_DURATION_SCATTER RECEPTION_WINDOW_DURATION_SCATTER - 10 // [ticks]
+#define TRANSMISSION_DURATION_SCATTER (100 * TICKS_PER_MILLISEC)       // [ticks]
+#ifdef ND_CONF_RECEPTION_DURATION_SCATTER
+#define RECEPTION_DURATION_SCATTER ND_CONF_RECEPTION_DURATION_SCATTER // [ticks]
+#else
+#define RECEPTION_DURATION_SCATTER RECEPTION_WINDOW_DURATION_SCATTER    // [ticks]
+#endif
 
-#define TRANSMISSION_PER_WINDOW_BURST TRANSMISSION_WINDOW_DURATION_BURST / TRANSMISSION_DURATION_BURST
+#define TRANSMISSION_PER_WINDOW_BURST (TRANSMISSION_WINDOW_DURATION_BURST / TRANSMISSION_DURATION_BURST)
 #define TRANSMISSION_PER_WINDOW_SCATTER 1
 
-#define TRANSMISSION_COLLISION_OFFSET (((unsigned short)rand()) % (10 * TICKS_PER_MILLISEC) + 0) // offset added to the transmission to avoid collisions
+// radio on time of one beacon: calibration plus 12 bytes at 250 kbps, ~0.6 ms
+#define ND_BEACON_TICKS ((uint32_t)TICKS_PER_SEC * 6 / 10000)
 
-#define EPOCH_COLLISION_OFFSET 0 //(((unsigned short)rand()) % 20 + 10) // offset added to the epoch end to avoid collision
+// longest epoch accepted by nd_start_with_budget(), gaps between two actions
+// must stay below half the rtimer range
+#define ND_EPOCH_TICKS_MAX 0x8000
 
-/*---------------------------------------------------------------------------*/
+#define ND_SLOT_TICKS (EPOCH_DURATION / ND_SLOTS_PER_EPOCH)
+// rest of the epoch after its slots, left idle after the last slot so that
+// the slotted epochs are as long as the others
+#define ND_SLOT_PAD (EPOCH_DURATION - ND_SLOTS_PER_EPOCH * ND_SLOT_TICKS)
 
-void nd_recv(void)
+// from the offset written in the beacon to the start of frame at the
+// receiver: rx/tx turnaround and preamble, ~0.35 ms
+#define ND_RDV_TX_DELAY ((uint32_t)TICKS_PER_SEC * 35 / 100000)
+
+// drift estimates are fed phases at most this many epochs apart, further
+// apart a neighbour whose phase moved more than ND_RDV_DRIFT_JUMP from the
+// prediction is taken as restarted, and its estimate starts over
+#define ND_RDV_DRIFT_GAP 64
+#define ND_RDV_DRIFT_JUMP ((int32_t)(4 * ND_RDV_GUARD))
+#define ND_RDV_DRIFT_MAX 0x7FFF
+
+// transmissions are delayed by a random offset below this [ticks]
+#ifdef ND_CONF_COLLISION_OFFSET_MAX
+#define ND_COLLISION_OFFSET_MAX ND_CONF_COLLISION_OFFSET_MAX
+#else
+#define ND_COLLISION_OFFSET_MAX (10 * TICKS_PER_MILLISEC)
+#endif
+#define TRANSMISSION_COLLISION_OFFSET (((unsigned short)rand()) % jitter_max + 0) // offset added to the transmission to avoid collisions
+
+// actions of the per-epoch schedule
+#define ND_ACTION_TX 0
+#define ND_ACTION_RX_ON 1
+#define ND_ACTION_RX_OFF 2
+#define ND_ACTION_END 3  // end of the schedule period
+#define ND_ACTION_SLOT 4 // start of a slot, decides if it is awake
+#define ND_ACTION_PHASE 5 // only moves to the phase of the entry
+
+#define ND_SLOT_JITTER 0x01 // add the collision offset of the epoch
+#define ND_SLOT_AWAKE 0x02  // only in awake slots
+#define ND_SLOT_ADAPT 0x04  // reception window i, see ND_SLOT_LISTEN()
+#define ND_SLOT_LISTEN(i) (ND_SLOT_ADAPT | (((i) & 0x0F) << 4))
+
+#define ND_SCHEDULE_MAX 48
+#define ND_SCHEDULE_MIN_DELAY 2 // [ticks] rtimer_set() needs a time in the future
+
+// The schedules nd_start() compiles from the parameters above must be valid
+// for the RTIMER_SECOND of the target, as the integer divisions above can
+// silently give 0 or windows that do not fit. These are C checks, not #if,
+// so that a tick constant wrapping on a 16 bit target fails them as well.
+ND_STATIC_ASSERT(EPOCH_DURATION <= ND_EPOCH_TICKS_MAX, epoch_longer_than_0x8000_ticks);
+ND_STATIC_ASSERT(TICKS_PER_MILLISEC != 0 && ND_BEACON_TICKS != 0, rtimer_too_slow_durations_truncate_to_0);
+ND_STATIC_ASSERT(ND_COLLISION_OFFSET_MAX >= 1, collision_offset_max_below_1_tick);
+
+// BURST: beacons fit their window, listens catch a beacon and the last one,
+// ending the epoch, does not overlap the one of the last window
+ND_STATIC_ASSERT(RECEPTION_WINDOW_COUNT_BURST >= 1 && WINDOW_LEN_BURST != 0, burst_needs_a_reception_window);
+ND_STATIC_ASSERT(TRANSMISSION_DURATION_BURST >= ND_BEACON_TICKS && TRANSMISSION_PER_WINDOW_BURST >= 1,
+                 burst_transmission_duration_not_between_a_beacon_and_a_window);
+ND_STATIC_ASSERT(RECEPTION_DURATION_BURST > ND_BEACON_TICKS, burst_listens_not_longer_than_a_beacon);
+ND_STATIC_ASSERT((TRANSMISSION_WINDOW_COUNT_BURST + RECEPTION_WINDOW_COUNT_BURST - 1) * WINDOW_LEN_BURST +
+                         2 * RECEPTION_DURATION_BURST <=
+                     EPOCH_DURATION,
+                 burst_listens_overlap_at_the_epoch_end);
+// beacons, the phase change, two entries per listen and the epoch end
+ND_STATIC_ASSERT(TRANSMISSION_WINDOW_COUNT_BURST * TRANSMISSION_PER_WINDOW_BURST + 2 * (RECEPTION_WINDOW_COUNT_BURST + 1) + 2 <=
+                     ND_SCHEDULE_MAX,
+                 burst_schedule_longer_than_nd_schedule_max);
+
+// SCATTER: one window listened, at least one with a beacon
+ND_STATIC_ASSERT(TRANSMISSION_WINDOW_COUNT_SCATTER >= 1, scatter_needs_epochs_of_200_ms);
+ND_STATIC_ASSERT(RECEPTION_DURATION_SCATTER > ND_BEACON_TICKS &&
+                     RECEPTION_DURATION_SCATTER <= RECEPTION_WINDOW_DURATION_SCATTER,
+                 scatter_reception_duration_not_between_a_beacon_and_a_window);
+// boundary beacon and phase change, listens split for adaptive listening,
+// beacons and the epoch end
+ND_STATIC_ASSERT(2 + 2 * RECEPTION_WINDOW_COUNT_SCATTER * (1 << ND_ADAPTIVE_MAX_LEVEL) + TRANSMISSION_WINDOW_COUNT_SCATTER + 1 <=
+                     ND_SCHEDULE_MAX,
+                 scatter_schedule_longer_than_nd_schedule_max);
+
+// slotted: the jittered first beacon and the last one fit around the listen
+ND_STATIC_ASSERT(ND_SLOT_TICKS / 4 + 2 * ND_BEACON_TICKS <= ND_SLOT_TICKS, slots_per_epoch_too_large_for_the_epoch);
+
+ND_STATIC_ASSERT(ND_RDV_TX_DELAY != 0, rdv_tx_delay_truncates_to_0);
+ND_STATIC_ASSERT(ND_RDV_TX_DELAY + ND_BEACON_TICKS + 2 * ND_RDV_GUARD <= EPOCH_DURATION / 2, rdv_guard_too_long_for_the_epoch);
+
+// One entry of the schedule, offsets are relative to the epoch start
+struct nd_slot
 {
-  /* New packet received
-   * 1. Read packet from packetbuf---packetbuf_dataptr()
-   * 2. If a new neighbor is discovered within the epoch, notify the application
-   * NOTE: The testbed's firefly nodes can receive packets only if they are at
-   * least 3 bytes long (5 considering the CRC).
-   * If while you are testing you receive nothing make sure your packet is long enough
-   */
+  rtimer_clock_t offset;
+  uint8_t action;
+  uint8_t flags;
+  uint8_t phase; // ND_PHASE_* charged from this entry on
+};
 
-  uint32_t nbr_id;
+// The epoch is compiled once by nd_start() into a table of actions sorted by
+// offset, which a single rtimer steps through.
+struct nd_slot schedule[ND_SCHEDULE_MAX];
+uint8_t schedule_len = 0;
+uint8_t schedule_pos = 0;
+static struct rtimer nd_timer;
 
-  memcpy(&nbr_id, packetbuf_dataptr(), sizeof(uint32_t));
+static void nd_schedule_timeout(struct rtimer *t, void *ptr);
 
-  /*
-  if (packetbuf_datalen() != sizeof(unsigned short))
-  {
-    printf("invalid payload len. Value read: %u\n", nbr_id);
-    return;
-  }
-  */
+PROCESS(nd_process, "ND process");
 
-  if (nbr_id == 0)
+static const char *const nd_mode_names[] = {
+    "", "BURST", "SCATTER", "DISCO", "UCONNECT", "SEARCHLIGHT"};
+
+/*---------------------------------------------------------------------------*/
+
+/**
+ * First slot probed for an id. The testbed ids are sparse, their dense
+ * index in the deployment table spreads them evenly: the first MAX_NBR
+ * nodes of the table never share a slot.
+ */
+static uint8_t nd_nbr_home(uint16_t nbr_id)
+{
+#if CONTIKI_TARGET_ZOUL
+  int16_t i = deployment_index(nbr_id);
+  if (i >= 0)
   {
-    return; // idk why but sometimes has payload 0
+    return i & ND_NBR_MASK;
   }
+#endif
+  return nbr_id & ND_NBR_MASK;
+}
 
-  /*
-  int i = 0;
-  for (i; i < 11; i++)
-  {
-    printf("Neighbours: %d", neighbors[i]);
-  };
-  printf("\n");
-  */
+/**
+ * Returns the record of nbr_id, or NULL if it is not a known neighbour
+ */
+const struct nd_nbr *nd_nbr_lookup(uint16_t nbr_id)
+{
+  uint8_t slot = nd_nbr_home(nbr_id);
+  uint8_t probes = 0;
 
-  // check if neigh already found, otherwise set to found
-  if (nbr_id < MAX_NBR)
+  for (; probes < MAX_NBR && nbr_table[slot].id != 0; probes++)
   {
-    if (!neighbors_act_epoch[nbr_id]) {
-      discovered_n_epoch++;
-      neighbors_act_epoch[nbr_id] = true;
-    }
-    
-    if (!neighbors[nbr_id])
+    if (nbr_table[slot].id == nbr_id)
     {
-      neighbors[nbr_id] = true;
-      discovered_n_epoch_new++;
-
-      if (app_cb.nd_new_nbr != NULL) // sometimes the first one happens to be NULL
-      {
-        app_cb.nd_new_nbr(epoch, nbr_id);
-      }
-      else
-      {
-        printf("app_cb.nd_new_nbr is NULL\n");
-      }
+      return &nbr_table[slot];
     }
+    slot = (slot + 1) & ND_NBR_MASK;
   }
+  return NULL;
 }
 
-/*
- * Sends a beacon
+/**
+ * First used record at or after nbr, which may be one past the table
  */
-void nd_send_beacon(void)
+static const struct nd_nbr *nd_nbr_from(const struct nd_nbr *nbr)
+{
+  for (; nbr < nbr_table + MAX_NBR; nbr++)
+  {
+    if (nbr->id != 0)
+    {
+      return nbr;
+    }
+  }
+  return NULL;
+}
+
+const struct nd_nbr *nd_nbr_head(void)
+{
+  return nd_nbr_from(nbr_table);
+}
+
+const struct nd_nbr *nd_nbr_next(const struct nd_nbr *nbr)
+{
+  return nd_nbr_from(nbr + 1);
+}
+
+uint8_t nd_nbr_count(void)
+{
+  return nbr_count;
+}
+
+uint8_t nd_nbr_snapshot(struct nd_nbr *dst, uint8_t max)
 {
-  int ret = NETSTACK_RADIO.send(&nid, sizeof(uint32_t));
-  if (ret == RADIO_TX_COLLISION)
+  const struct nd_nbr *nbr = nd_nbr_head();
+  uint8_t n = 0;
+
+  for (; nbr != NULL && n < max; nbr = nd_nbr_next(nbr))
   {
-    //printf("there was a collision\n");
-    // adds an offset to the epoch to try avoid a collision again
-    epoch_start = epoch_start + EPOCH_COLLISION_OFFSET;
-    collision = true;
+    dst[n++] = *nbr;
   }
+  return n;
+}
 
-  sent_beacon_count++;
+/**
+ * Removes the record in slot, shifting back the following records of the
+ * probe sequence so that lookups never stop at the hole
+ */
+static void nd_nbr_remove(uint8_t slot)
+{
+  uint8_t next = slot;
 
-  if (sent_beacon_count != TRANSMISSION_PER_WINDOW)
+  nbr_table[slot].id = 0;
+  nbr_count--;
+  for (;;)
   {
-    unsigned short send_time = 0;
-    if (sent_beacon_count == TRANSMISSION_PER_WINDOW - 1)
+    next = (next + 1) & ND_NBR_MASK;
+    if (nbr_table[next].id == 0)
     {
-      // if it is the last beacon avoid putting the collision offset to not go out of the epoch
-      send_time = epoch_start + (sent_beacon_count * TRANSMISSION_DURATION) + (RECEPTION_WINDOW_DURATION * (FIRST_TRANSMIT ? 0 : 1));
+      break;
     }
-    else
+    uint8_t home = nd_nbr_home(nbr_table[next].id);
+    if (((next - home) & ND_NBR_MASK) >= ((next - slot) & ND_NBR_MASK))
     {
-      send_time = epoch_start + (sent_beacon_count * TRANSMISSION_DURATION) + (RECEPTION_WINDOW_DURATION * (FIRST_TRANSMIT ? 0 : 1)) + (collision ? collision_offset : 0);
+      nbr_table[slot] = nbr_table[next];
+      nbr_table[next].id = 0;
+      slot = next;
     }
-    static struct rtimer beacon_timer;
-    rtimer_set(
-        &beacon_timer,
-        send_time, // set next beacon wrt to epoch start
-        0,
-        (rtimer_callback_t)nd_send_beacon,
-        NULL);
   }
-  else
+}
+
+/**
+ * Adds a new neighbour. When the table is full, the neighbour heard least
+ * recently is evicted, unless all of them were heard in this epoch.
+ */
+static struct nd_nbr *nd_nbr_add(uint16_t nbr_id)
+{
+  uint8_t slot;
+
+  if (nbr_count == MAX_NBR)
   {
-    transmit_window_count++;
-    sent_beacon_count = 0;
-    if (transmit_window_count != TRANSMISSION_WINDOW_COUNT)
+    uint8_t stalest = 0;
+    for (slot = 1; slot < MAX_NBR; slot++)
     {
-      unsigned short send_time = 0;
-      if (transmit_window_count == TRANSMISSION_WINDOW_COUNT - 1)
-      {
-        // Avoid collision offset to not go out of epoch
-        send_time = epoch_start + (TRANSMISSION_WINDOW_DURATION * transmit_window_count) + (RECEPTION_WINDOW_DURATION * (FIRST_TRANSMIT ? 0 : 1));
-      }
-      else
+      if ((uint16_t)(nbr_epoch - nbr_table[slot].last_seen) > (uint16_t)(nbr_epoch - nbr_table[stalest].last_seen))
       {
-        send_time = epoch_start + (TRANSMISSION_WINDOW_DURATION * transmit_window_count) + (RECEPTION_WINDOW_DURATION * (FIRST_TRANSMIT ? 0 : 1)) + (collision ? collision_offset : 0);
+        stalest = slot;
       }
-      // do another transmission window
-      static struct rtimer beacon_timer;
-      rtimer_set(
-          &beacon_timer,
-          send_time,
-          0,
-          (rtimer_callback_t)nd_send_beacon,
-          NULL);
     }
-    else
+    if (nbr_table[stalest].last_seen == nbr_epoch)
     {
-      transmit_window_count = 0;
-      // if it transmit before receiving in an epoch, go to listen window
-      // otherwise end epoch
+      return NULL;
+    }
+    nd_nbr_remove(stalest);
+  }
 
-      if (FIRST_TRANSMIT)
-      {
-        // do a reception window
-        // call nd_listen when recv window starts
-        static struct rtimer start_listening;
-        rtimer_set(
-            &start_listening,
-            // wait the remainig time and then listen again
-            epoch_start + TRANSMISSION_WINDOW_DURATION,
-            0,
-            (rtimer_callback_t)nd_listen,
-            NULL);
-      }
-      else
-      {
-        static struct rtimer epoch_end;
-        rtimer_set(
-            &epoch_end,
-            // wait the remainig time and then call epoch end
-            epoch_start + EPOCH_DURATION,
-            0,
-            (rtimer_callback_t)nd_step,
-            NULL);
-      }
+  slot = nd_nbr_home(nbr_id);
+  while (nbr_table[slot].id != 0)
+  {
+    slot = (slot + 1) & ND_NBR_MASK;
+  }
+
+  struct nd_nbr *nbr = &nbr_table[slot];
+  memset(nbr, 0, sizeof(*nbr));
+  nbr->id = nbr_id;
+  nbr->first_seen = nbr_epoch;
+  nbr->last_seen = nbr_epoch - 1;
+  nbr->phase = 0xFFFF;
+  nbr_count++;
+  return nbr;
+}
+
+/**
+ * Forgets the neighbours not heard for more than ND_NBR_MAX_AGE epochs
+ */
+static void nd_nbr_age(void)
+{
+#if ND_NBR_MAX_AGE
+  uint8_t slot = 0;
+  while (slot < MAX_NBR)
+  {
+    if (nbr_table[slot].id != 0 && (uint16_t)(nbr_epoch - nbr_table[slot].last_seen) > ND_NBR_MAX_AGE)
+    {
+      nd_nbr_remove(slot); // a following record may have moved here
+    }
+    else
+    {
+      slot++;
     }
   }
+#endif
 }
 
 /**
- * Callback to stop listening
+ * Goes back to listening at full rate
  */
-void nd_stop_listen(void)
+static void nd_listen_reset(void)
 {
-  NETSTACK_RADIO.off();
-  listen_count++;
+  listen_level = 0;
+  quiet_epochs = 0;
+}
 
-  if (listen_count < RECEPTION_WINDOW_COUNT)
+/**
+ * Lowers the listening rate after ND_ADAPTIVE_QUIET_EPOCHS quiet epochs
+ */
+static void nd_listen_adapt(void)
+{
+  if (gossip_boost != 0)
+  {
+    gossip_boost--;
+    quiet_epochs = 0;
+    return;
+  }
+  if (!adaptive || discovered_n_epoch_new != 0)
   {
-    static struct rtimer start_listening;
-    rtimer_set(
-        &start_listening,
-        // wait the remainig time and then listen again
-        epoch_start + (RECEPTION_WINDOW_DURATION * (FIRST_TRANSMIT ? listen_count + 1 : listen_count)),
-        0,
-        (rtimer_callback_t)nd_listen,
-        NULL);
+    return;
   }
-  else
+  if (++quiet_epochs >= ND_ADAPTIVE_QUIET_EPOCHS)
   {
-    if (FIRST_TRANSMIT && listen_count == RECEPTION_WINDOW_COUNT)
+    quiet_epochs = 0;
+    if (listen_level < ND_ADAPTIVE_MAX_LEVEL)
     {
-      // do last one receive just before end of epoch
-      static struct rtimer start_listening;
-      rtimer_set(
-          &start_listening,
-          // wait the remainig time and then listen again
-          epoch_start + EPOCH_DURATION - RECEPTION_DURATION - 20, // -10 to give some thresold
-          0,
-          (rtimer_callback_t)nd_listen_last,
-          NULL);
+      listen_level++;
     }
-    else
+  }
+}
+
+/**
+ * Moves the digest to the next slice holding known neighbours
+ */
+static void nd_gossip_rotate(void)
+{
+  uint16_t next = 0xFFFF;  // first slice after the current one
+  uint16_t first = 0xFFFF; // first slice overall
+  uint8_t i;
+
+  for (i = 0; i < MAX_NBR; i++)
+  {
+    if (nbr_table[i].id != 0)
     {
-      listen_count = 0;
-      // if first transmit in epoch, then after listen end epoch, otherwise
-      // go to transmit
-      if (FIRST_TRANSMIT)
+      uint16_t slice = nbr_table[i].id / ND_DIGEST_BITS;
+      if (slice < first)
       {
-        static struct rtimer epoch_end;
-        rtimer_set(
-            &epoch_end,
-            // wait the remainig time and then call epoch end
-            epoch_start + EPOCH_DURATION,
-            0,
-            (rtimer_callback_t)nd_step,
-            NULL);
+        first = slice;
       }
-      else
+      if (slice > digest_slice && slice < next)
       {
-        static struct rtimer start_transmitting;
-        rtimer_set(
-            &start_transmitting,
-            // wait the remainig time and then listen again
-            epoch_start + (RECEPTION_WINDOW_DURATION * RECEPTION_WINDOW_COUNT),
-            0,
-            (rtimer_callback_t)nd_send_beacon,
-            NULL);
+        next = slice;
       }
     }
   }
+  digest_slice = next != 0xFFFF ? next : first;
 }
 
 /**
- * Does the last listening step just before transmit in burst
+ * Fills view with the digest of the current slice
  */
-void nd_listen_last(void)
+static void nd_gossip_view(struct nd_nbr_view *view)
 {
-  NETSTACK_RADIO.on(); // start listening
-  // set callback to stop listening
-  static struct rtimer stop_listening;
-  rtimer_set(
-      &stop_listening,
-      epoch_start + EPOCH_DURATION - 20, // -20 is to have some thresold
-      0,
-      (rtimer_callback_t)nd_stop_listen,
-      NULL);
+  uint8_t i;
+
+  view->slice = digest_slice;
+  memset(view->digest, 0, sizeof(view->digest));
+  for (i = 0; i < MAX_NBR; i++)
+  {
+    if (nbr_table[i].id != 0 && nbr_table[i].id / ND_DIGEST_BITS == digest_slice)
+    {
+      uint8_t bit = nbr_table[i].id % ND_DIGEST_BITS;
+      view->digest[bit >> 3] |= 1 << (bit & 7);
+    }
+  }
 }
 
 /**
- * Callback to start listening
+ * Copies the published digest into the beacon
  */
-void nd_listen(void)
+static void nd_gossip_digest(void)
 {
-  NETSTACK_RADIO.on(); // start listening
-  // set callback to stop listening
-  static struct rtimer stop_listening;
-  rtimer_set(
-      &stop_listening,
-      epoch_start + (RECEPTION_WINDOW_DURATION * (FIRST_TRANSMIT ? listen_count + 1 : listen_count)) + RECEPTION_DURATION,
-      0,
-      (rtimer_callback_t)nd_stop_listen,
-      NULL);
+  const struct nd_nbr_view *view = &nbr_view[nbr_view_pub];
+
+  beacon.slice = view->slice;
+  memcpy(beacon.digest, view->digest, sizeof(beacon.digest));
+  nd_rdc_beacon_changed();
 }
 
 /**
- * Function called each end of epoch
+ * Removes nbr_id from the candidates, returns true if it was pending
  */
-void nd_step()
+static bool nd_gossip_found(uint16_t nbr_id)
 {
-  if (epoch != 0)
+  uint8_t i;
+
+  for (i = 0; i < ND_GOSSIP_CANDIDATES; i++)
   {
-    app_cb.nd_epoch_end(epoch, discovered_n_epoch, discovered_n_epoch_new);
+    if (candidates[i].id == nbr_id)
+    {
+      candidates[i].id = 0;
+      return (uint16_t)(nbr_epoch - candidates[i].since) <= ND_GOSSIP_BOOST_EPOCHS;
+    }
   }
+  return false;
+}
+
+/**
+ * Records an id advertised by a neighbour, boosting listening if it is new
+ */
+static void nd_gossip_candidate(uint16_t id)
+{
+  uint8_t i;
+  uint8_t free = ND_GOSSIP_CANDIDATES;
 
-  if (!FIRST_TRANSMIT)
+  for (i = 0; i < ND_GOSSIP_CANDIDATES; i++)
+  {
+    if (candidates[i].id == id)
+    {
+      return;
+    }
+    if (candidates[i].id == 0 || (uint16_t)(nbr_epoch - candidates[i].since) > ND_GOSSIP_RETRY)
+    {
+      free = i;
+    }
+  }
+  if (free == ND_GOSSIP_CANDIDATES)
   {
-    // if scatter: transmit at the end of the epoch before starting to listen
-    NETSTACK_RADIO.send(&nid, sizeof(uint32_t));
+    return;
   }
-  epoch++;
-  listen_count = 0;
-  discovered_n_epoch = 0;
-  discovered_n_epoch_new = 0;
-  sent_beacon_count = 0;
+  candidates[free].id = id;
+  candidates[free].since = nbr_epoch;
+  gossip_boost = ND_GOSSIP_BOOST_EPOCHS;
+  nd_listen_reset();
+}
 
-  // reset neighbours bitset
-  int i = 0;
-  for (; i < MAX_NBR; i++)
+/**
+ * Looks for candidates in the digest of a received beacon
+ */
+static void nd_gossip_learn(const struct beacon_msg *msg)
+{
+  uint16_t base = msg->slice * ND_DIGEST_BITS;
+  uint8_t i, bit;
+
+  for (i = 0; i < sizeof(msg->digest); i++)
   {
-    neighbors_act_epoch[i] = false;
+    for (bit = 0; msg->digest[i] >> bit; bit++)
+    {
+      uint16_t id = base + (i << 3) + bit;
+      if ((msg->digest[i] & (1 << bit)) && id != node_id && nd_nbr_lookup(id) == NULL)
+      {
+        nd_gossip_candidate(id);
+      }
+    }
   }
+}
+
+/**
+ * Number of candidates advertised in the last ND_GOSSIP_BOOST_EPOCHS epochs
+ */
+static uint8_t nd_gossip_pending(void)
+{
+  uint8_t i, n = 0;
 
-  printf("NCO: %u\n", collision_offset);
-  if (epoch_start != 0)
+  for (i = 0; i < ND_GOSSIP_CANDIDATES; i++)
   {
-    epoch_start = epoch_start + EPOCH_DURATION + (collision ? EPOCH_COLLISION_OFFSET : 0);
+    if (candidates[i].id != 0 && (uint16_t)(nbr_epoch - candidates[i].since) <= ND_GOSSIP_BOOST_EPOCHS)
+    {
+      n++;
+    }
   }
-  else
+  return n;
+}
+
+/**
+ * Start of frame of the beacon in packetbuf, as timestamped by the radio
+ */
+static rtimer_clock_t nd_rx_timestamp(void)
+{
+  rtimer_clock_t ts = (rtimer_clock_t)packetbuf_attr(PACKETBUF_ATTR_TIMESTAMP);
+
+  return ts != 0 ? ts : RTIMER_NOW();
+}
+
+/**
+ * Ticks from nd_start() to t, a tick of the current epoch or shortly
+ * before it
+ */
+static uint32_t nd_elapsed(rtimer_clock_t t)
+{
+  uint32_t start = epoch_start - start_tick;
+
+  if (RTIMER_CLOCK_LT(t, EPOCH_TICK(0)))
   {
-    epoch_start = rtimer_arch_now();
+    return start - (rtimer_clock_t)(EPOCH_TICK(0) - t);
   }
+  return start + EPOCH_OFFSET(t);
+}
 
-  // collision = false; //uncomment to add slack only after a collision
-  collision_offset = TRANSMISSION_COLLISION_OFFSET;
+/**
+ * Start of the sender's epoch within ours, from the offset in its beacon
+ */
+static uint16_t nd_rdv_phase(uint16_t offset)
+{
+  rtimer_clock_t ts = nd_rx_timestamp();
+  int32_t phase;
 
-  if (FIRST_TRANSMIT)
+  phase = (int16_t)EPOCH_OFFSET(ts - ND_RDV_TX_DELAY - offset);
+  while (phase < 0)
   {
-    nd_send_beacon();
+    phase += epoch_duration;
   }
-  else
+  while (phase >= (int32_t)epoch_duration)
   {
-    nd_listen();
+    phase -= epoch_duration;
   }
+  return (uint16_t)phase;
 }
 
-/*---------------------------------------------------------------------------*/
-void nd_start(uint8_t mode, const struct nd_callbacks *cb)
+/**
+ * Difference of two phases, wrapped to half an epoch either way [ticks]
+ */
+static int32_t nd_rdv_phase_diff(uint16_t a, uint16_t b)
 {
-  /* Start seleced ND primitive and set nd_callbacks */
+  int32_t d = (int32_t)a - b;
 
-  // set reference of callbacks
-  app_cb.nd_new_nbr = cb->nd_new_nbr;
-  app_cb.nd_epoch_end = cb->nd_epoch_end;
+  if (d > (int32_t)(epoch_duration / 2))
+  {
+    d -= epoch_duration;
+  }
+  else if (d < -(int32_t)(epoch_duration / 2))
+  {
+    d += epoch_duration;
+  }
+  return d;
+}
 
-  nid = (uint32_t) node_id;
+/**
+ * Phase of a neighbour in epoch e, extrapolated from the one measured in
+ * phase_epoch with its drift estimate
+ */
+static uint16_t nd_rdv_predict(uint16_t measured, int16_t drift, uint16_t phase_epoch, uint16_t e)
+{
+  int32_t phase = measured + ((int32_t)drift * (uint16_t)(e - phase_epoch)) / 256;
 
-  // init neighbours bitset
-  int i = 0;
-  for (; i < MAX_NBR; i++)
+  while (phase < 0)
+  {
+    phase += epoch_duration;
+  }
+  while (phase >= (int32_t)epoch_duration)
   {
-    neighbors[i] = false;
-    neighbors_act_epoch[i] = false;
+    phase -= epoch_duration;
   }
+  return (uint16_t)phase;
+}
 
-  switch (mode)
+/**
+ * Takes the phase measured in epoch e: the error against the prediction,
+ * spread over the epochs since the last measure, corrects the drift
+ * estimate by a quarter
+ */
+static void nd_rdv_track(struct nd_nbr *nbr, uint16_t phase, uint16_t e)
+{
+  uint16_t gap = e - nbr->phase_epoch;
+  int32_t err, drift;
+
+  if (nbr->phase == 0xFFFF || gap > ND_RDV_DRIFT_GAP)
   {
-  case ND_BURST:
+    nbr->drift = 0;
+  }
+  else if (gap != 0)
   {
-    // set settings for BURST primitive
-    TRANSMISSION_PER_WINDOW = TRANSMISSION_PER_WINDOW_BURST;
-    TRANSMISSION_WINDOW_COUNT = TRANSMISSION_WINDOW_COUNT_BURST;
-    RECEPTION_WINDOW_COUNT = RECEPTION_WINDOW_COUNT_BURST;
-    WINDOW_LEN = WINDOW_LEN_BURST;
-    TRANSMISSION_DURATION = TRANSMISSION_DURATION_BURST; // WHY THIS IS 0
-    RECEPTION_DURATION = RECEPTION_DURATION_BURST;
-    RECEPTION_WINDOW_DURATION = RECEPTION_WINDOW_DURATION_BURST;
-    TRANSMISSION_WINDOW_DURATION = TRANSMISSION_WINDOW_DURATION_BURST;
-    FIRST_TRANSMIT = true;
-    printf(
-        "START: BURST, %d, %d, %d, %d, %d, %d, %d\n",
-        TRANSMISSION_WINDOW_COUNT,
-        RECEPTION_WINDOW_COUNT,
-        TRANSMISSION_WINDOW_DURATION,
-        RECEPTION_WINDOW_DURATION,
-        TRANSMISSION_PER_WINDOW,
-        TRANSMISSION_DURATION,
-        RECEPTION_DURATION);
-    printf(
-        "START: TYPE, \
-        TRANSMISSION_WINDOW_COUNT, \
-        RECEPTION_WINDOW_COUNT, \
-        TRANSMISSION_WINDOW_DURATION, \
+    err = nd_rdv_phase_diff(phase, nd_rdv_predict(nbr->phase, nbr->drift, nbr->phase_epoch, e));
+    if (err > ND_RDV_DRIFT_JUMP || err < -ND_RDV_DRIFT_JUMP)
+    {
+      nbr->drift = 0;
+    }
+    else
+    {
+      drift = nbr->drift + (err * 256 / gap) / 4;
+      if (drift > ND_RDV_DRIFT_MAX)
+      {
+        drift = ND_RDV_DRIFT_MAX;
+      }
+      else if (drift < -ND_RDV_DRIFT_MAX)
+      {
+        drift = -ND_RDV_DRIFT_MAX;
+      }
+      nbr->drift = (int16_t)drift;
+    }
+  }
+  nbr->phase = phase;
+  nbr->phase_epoch = e;
+}
+
+/**
+ * Fills view with the neighbours heard recently whose phase is known
+ */
+static void nd_rdv_view(struct nd_nbr_view *view)
+{
+  uint8_t i;
+
+  view->rdv_len = 0;
+  for (i = 0; i < MAX_NBR && view->rdv_len < ND_RDV_MAX; i++)
+  {
+    const struct nd_nbr *nbr = &nbr_table[i];
+    if (nbr->id == 0 || nbr->phase == 0xFFFF || (uint16_t)(nbr_epoch - nbr->last_seen) > ND_RDV_MAX_AGE)
+    {
+      continue;
+    }
+    struct nd_rdv_nbr *r = &view->rdv[view->rdv_len++];
+    r->phase = nbr->phase;
+    r->phase_epoch = nbr->phase_epoch;
+    r->drift = nbr->drift;
+    r->last_seen = nbr->last_seen;
+  }
+}
+
+/**
+ * Plans the rendezvous of the epoch: a listen around the epoch start of
+ * each neighbour of the published view heard recently, sorted and merged
+ * when they overlap
+ */
+static void nd_rdv_plan(void)
+{
+  const struct nd_nbr_view *view = &nbr_view[nbr_view_pub];
+  uint8_t i, j;
+
+  rdv_len = 0;
+  rdv_pos = 0;
+  for (i = 0; i < view->rdv_len; i++)
+  {
+    const struct nd_rdv_nbr *nbr = &view->rdv[i];
+    if ((uint16_t)(epoch - nbr->last_seen) > ND_RDV_MAX_AGE)
+    {
+      continue;
+    }
+    struct nd_rdv r;
+    uint16_t phase = nd_rdv_predict(nbr->phase, nbr->drift, nbr->phase_epoch, epoch);
+    r.on = phase > ND_RDV_GUARD ? phase - ND_RDV_GUARD : 0;
+    r.off = (rtimer_clock_t)phase + ND_RDV_TX_DELAY + ND_BEACON_TICKS + ND_RDV_GUARD;
+    if (r.off > epoch_duration)
+    {
+      r.off = epoch_duration;
+    }
+    // insertion by start time
+    for (j = rdv_len; j > 0 && rdv[j - 1].on > r.on; j--)
+    {
+      rdv[j] = rdv[j - 1];
+    }
+    rdv[j] = r;
+    rdv_len++;
+  }
+
+  for (i = 0, j = 0; i < rdv_len; i++)
+  {
+    if (j > 0 && rdv[i].on <= rdv[j - 1].off)
+    {
+      if (rdv[i].off > rdv[j - 1].off)
+      {
+        rdv[j - 1].off = rdv[i].off;
+      }
+    }
+    else
+    {
+      rdv[j++] = rdv[i];
+    }
+  }
+  rdv_len = j;
+  rendezvous_n = j;
+}
+
+void nd_recv(void)
+{
+  /* New packet received
+   * 1. Read packet from packetbuf---packetbuf_dataptr()
+   * 2. Queue it for nd_process, which updates the neighbour table and
+   *    notifies the application of new neighbors
+   * NOTE: The testbed's firefly nodes can receive packets only if they are at
+   * least 3 bytes long (5 considering the CRC).
+   * If while you are testing you receive nothing make sure your packet is long enough
+   */
+
+  uint16_t len = packetbuf_datalen();
+  uint8_t head = rx_head;
+  struct nd_rx_event *ev = &rx_queue[head & ND_RX_QUEUE_MASK];
+
+  if (len < sizeof(uint32_t))
+  {
+    return;
+  }
+  if ((uint8_t)(head - rx_tail) == ND_RX_QUEUE_LEN)
+  {
+    rx_dropped++;
+    return;
+  }
+
+  memset(&ev->msg, 0, sizeof(ev->msg));
+  ev->len = len < sizeof(ev->msg) ? len : sizeof(ev->msg);
+  memcpy(&ev->msg, packetbuf_dataptr(), ev->len);
+  if (ev->msg.nid == 0 || ev->msg.nid > 0xFFFF)
+  {
+    return; // idk why but sometimes has payload 0
+  }
+  ev->epoch = epoch;
+#if ND_LATENCY
+  ev->heard = nd_elapsed(nd_rx_timestamp());
+#endif
+  ev->rssi = (int8_t)packetbuf_attr(PACKETBUF_ATTR_RSSI);
+  ev->lqi = (uint8_t)packetbuf_attr(PACKETBUF_ATTR_LINK_QUALITY);
+  // the phase needs the reception time against the current epoch start
+  ev->phase = 0xFFFF;
+  if (rendezvous && ev->len >= ND_BEACON_HDR_LEN && ev->msg.offset != 0xFFFF)
+  {
+    ev->phase = nd_rdv_phase(ev->msg.offset);
+  }
+
+  rx_head = head + 1; // publishes the event
+  process_poll(&nd_process);
+}
+
+/**
+ * Applies a received beacon to the neighbour table
+ */
+static void nd_rx_apply(const struct nd_rx_event *ev)
+{
+  uint16_t nbr_id = (uint16_t)ev->msg.nid;
+  struct nd_nbr *nbr = (struct nd_nbr *)nd_nbr_lookup(nbr_id);
+  bool is_new = (nbr == NULL);
+  if (is_new)
+  {
+    nbr = nd_nbr_add(nbr_id);
+    if (nbr == NULL)
+    {
+      return; // no room left for a new neighbour
+    }
+  }
+
+  // a neighbour heard again after missing for several rotations of the
+  // reception windows brings listening back to full rate
+  if (!is_new && (uint16_t)(nbr_epoch - nbr->last_seen) > (4u << ND_ADAPTIVE_MAX_LEVEL))
+  {
+    nd_listen_reset();
+  }
+
+  // check if neigh already found in this epoch, otherwise set to found
+  if (nbr->last_seen != nbr_epoch)
+  {
+    discovered_n_epoch++;
+    nbr->last_seen = nbr_epoch;
+  }
+  if (nbr->beacons != 0xFFFF)
+  {
+    nbr->beacons++;
+  }
+  nbr->rssi = ev->rssi;
+  nbr->lqi = ev->lqi;
+  if (ev->phase != 0xFFFF)
+  {
+    nd_rdv_track(nbr, ev->phase, ev->epoch);
+  }
+  if (gossip && ev->len >= sizeof(struct beacon_msg))
+  {
+    nd_gossip_learn(&ev->msg);
+  }
+
+  if (is_new)
+  {
+    discovered_n_epoch_new++;
+    nd_listen_reset();
+    if (gossip && nd_gossip_found(nbr_id))
+    {
+      gossip_hits++;
+    }
+
+#if ND_LATENCY
+    uint16_t heard[] = {nbr_epoch, nbr_id, (uint16_t)ev->heard, (uint16_t)(ev->heard >> 16)};
+    nd_log_write(ND_LOG_HEARD, heard, 4);
+#endif
+    if (app_cb.nd_new_nbr != NULL) // sometimes the first one happens to be NULL
+    {
+      app_cb.nd_new_nbr(nbr_epoch, nbr_id);
+    }
+  }
+}
+
+/**
+ * Sends the pending beacon through nd-rdc, which defers it while the channel
+ * is busy and drops it once it would miss tx_deadline
+ */
+static void nd_send_beacon(void)
+{
+  rtimer_clock_t now = EPOCH_OFFSET(RTIMER_NOW());
+  rtimer_clock_t left = RTIMER_CLOCK_LT(now, tx_deadline) ? tx_deadline - now : 0;
+  rtimer_clock_t backoff;
+
+  if (rendezvous)
+  {
+    beacon.offset = now;
+    nd_rdc_beacon_changed();
+  }
+  if (nd_rdc_send_beacon(&beacon, beacon_len, tx_attempt, left, &backoff) == ND_RDC_TX_DEFER)
+  {
+    tx_retry_at = now + backoff;
+    tx_attempt++;
+  }
+  else
+  {
+    tx_attempt = 0;
+  }
+}
+
+/**
+ * Appends an action to the schedule, entries must be added in time order.
+ * The last entry is kept for the epoch end, without which the schedule
+ * would never wrap.
+ */
+static void nd_schedule_add(rtimer_clock_t offset, uint8_t action, uint8_t flags, uint8_t phase)
+{
+  if (schedule_len == ND_SCHEDULE_MAX - (action != ND_ACTION_END))
+  {
+    printf("ND: schedule full, action %u at %u dropped\n", action, offset);
+    return;
+  }
+  schedule[schedule_len].offset = offset;
+  schedule[schedule_len].action = action;
+  schedule[schedule_len].flags = flags;
+  schedule[schedule_len].phase = phase;
+  schedule_len++;
+}
+
+/**
+ * Appends the beacons of a transmission window starting at offset. A beacon
+ * gets the collision offset only if it stays inside the window with it.
+ */
+static void nd_schedule_tx_window(rtimer_clock_t offset)
+{
+  int i;
+
+  for (i = 0; i < TRANSMISSION_PER_WINDOW; i++)
+  {
+    rtimer_clock_t t = offset + (rtimer_clock_t)i * TRANSMISSION_DURATION;
+    bool fits = t + jitter_max < offset + TRANSMISSION_WINDOW_DURATION;
+    // the very first beacon marks the start of the epoch
+    nd_schedule_add(t, ND_ACTION_TX, (t != 0 && fits) ? ND_SLOT_JITTER : 0, ND_PHASE_TX);
+  }
+}
+
+/**
+ * Entries nd_schedule_compile() lays out for BURST (burst) or SCATTER with
+ * beacons beacons and listens reception windows, with the current adaptive
+ * setting, or for a slot in the slotted modes
+ */
+static uint16_t nd_schedule_entries(bool burst, uint16_t beacons, uint16_t listens)
+{
+  if (slots_per_epoch != 0)
+  {
+    // slot start, listen, a beacon at each end and the slot end
+    return 6;
+  }
+  if (burst)
+  {
+    // beacons, the phase change, two entries per listen and for the last
+    // one, the epoch end
+    return beacons + 1 + 2 * (listens + 1) + 1;
+  }
+  // boundary beacon and phase change, listens split for adaptive listening,
+  // beacons and the epoch end
+  return 2 + 2 * listens * (adaptive ? (1 << ND_ADAPTIVE_MAX_LEVEL) : 1) + beacons + 1;
+}
+
+/**
+ * Compiles the windows of the selected primitive into the schedule, once.
+ * Returns false if they do not fit in ND_SCHEDULE_MAX entries.
+ */
+static bool nd_schedule_compile(void)
+{
+  int i;
+  uint16_t entries = nd_schedule_entries(FIRST_TRANSMIT, TRANSMISSION_WINDOW_COUNT * TRANSMISSION_PER_WINDOW,
+                                         RECEPTION_WINDOW_COUNT);
+
+  schedule_len = 0;
+  if (entries > ND_SCHEDULE_MAX)
+  {
+    printf("ND: schedule of %u entries, at most %u\n", entries, ND_SCHEDULE_MAX);
+    return false;
+  }
+  if (slots_per_epoch != 0)
+  {
+    // slotted: an awake slot listens between a beacon at each of its ends,
+    // so that two awake slots overlapping by a beacon discover each other.
+    // The first beacon is jittered, or nodes whose slots are aligned would
+    // always send at the same time.
+    nd_schedule_add(0, ND_ACTION_SLOT, 0, ND_PHASE_IDLE);
+    nd_schedule_add(0, ND_ACTION_RX_ON, ND_SLOT_AWAKE, ND_PHASE_RX);
+    nd_schedule_add(0, ND_ACTION_TX, ND_SLOT_AWAKE | ND_SLOT_JITTER, ND_PHASE_RX);
+    nd_schedule_add(epoch_duration - ND_BEACON_TICKS, ND_ACTION_RX_OFF, ND_SLOT_AWAKE, ND_PHASE_RX);
+    nd_schedule_add(epoch_duration - ND_BEACON_TICKS, ND_ACTION_TX, ND_SLOT_AWAKE, ND_PHASE_RX);
+  }
+  else if (FIRST_TRANSMIT)
+  {
+    // BURST: transmission windows, then short receptions at the start of
+    // each reception window and a last one just before the epoch ends
+    for (i = 0; i < TRANSMISSION_WINDOW_COUNT; i++)
+    {
+      nd_schedule_tx_window((rtimer_clock_t)i * TRANSMISSION_WINDOW_DURATION);
+    }
+    // the reception windows may all be skipped, leave the TX phase anyway
+    nd_schedule_add((rtimer_clock_t)TRANSMISSION_WINDOW_DURATION * TRANSMISSION_WINDOW_COUNT, ND_ACTION_PHASE, 0, ND_PHASE_IDLE);
+    for (i = 0; i < RECEPTION_WINDOW_COUNT; i++)
+    {
+      rtimer_clock_t t = (rtimer_clock_t)TRANSMISSION_WINDOW_DURATION * TRANSMISSION_WINDOW_COUNT + (rtimer_clock_t)i * RECEPTION_WINDOW_DURATION;
+      nd_schedule_add(t, ND_ACTION_RX_ON, ND_SLOT_LISTEN(i), ND_PHASE_RX);
+      nd_schedule_add(t + RECEPTION_DURATION, ND_ACTION_RX_OFF, ND_SLOT_LISTEN(i), ND_PHASE_IDLE);
+    }
+    nd_schedule_add(epoch_duration - RECEPTION_DURATION, ND_ACTION_RX_ON, ND_SLOT_LISTEN(i), ND_PHASE_LAST);
+    nd_schedule_add(epoch_duration, ND_ACTION_RX_OFF, ND_SLOT_LISTEN(i), ND_PHASE_IDLE);
+  }
+  else
+  {
+    // SCATTER: a beacon at the epoch boundary, the reception windows and
+    // then the transmission windows
+    nd_schedule_add(0, ND_ACTION_TX, 0, ND_PHASE_TX);
+    nd_schedule_add(0, ND_ACTION_PHASE, 0, ND_PHASE_IDLE);
+    for (i = 0; i < RECEPTION_WINDOW_COUNT; i++)
+    {
+      rtimer_clock_t t = (rtimer_clock_t)i * RECEPTION_WINDOW_DURATION;
+      if (adaptive)
+      {
+        // split in parts that can be skipped, a beacon period is then
+        // covered in 2^ND_ADAPTIVE_MAX_LEVEL epochs at most
+        int part;
+        rtimer_clock_t len = RECEPTION_DURATION >> ND_ADAPTIVE_MAX_LEVEL;
+        for (part = 0; part < (1 << ND_ADAPTIVE_MAX_LEVEL); part++)
+        {
+          rtimer_clock_t end = (part == (1 << ND_ADAPTIVE_MAX_LEVEL) - 1) ? t + RECEPTION_DURATION : t + (part + 1) * len;
+          nd_schedule_add(t + part * len, ND_ACTION_RX_ON, ND_SLOT_LISTEN(part), ND_PHASE_RX);
+          nd_schedule_add(end, ND_ACTION_RX_OFF, ND_SLOT_LISTEN(part), ND_PHASE_IDLE);
+        }
+      }
+      else
+      {
+        nd_schedule_add(t, ND_ACTION_RX_ON, 0, ND_PHASE_RX);
+        nd_schedule_add(t + RECEPTION_DURATION, ND_ACTION_RX_OFF, 0, ND_PHASE_IDLE);
+      }
+    }
+    for (i = 0; i < TRANSMISSION_WINDOW_COUNT; i++)
+    {
+      nd_schedule_tx_window((rtimer_clock_t)RECEPTION_WINDOW_DURATION * RECEPTION_WINDOW_COUNT + (rtimer_clock_t)i * TRANSMISSION_WINDOW_DURATION);
+    }
+  }
+  nd_schedule_add(epoch_duration, ND_ACTION_END, 0, ND_PHASE_IDLE);
+
+  rtimer_clock_t on_at = 0;
+  listen_full = 0;
+  for (i = 0; i < schedule_len; i++)
+  {
+    if (schedule[i].action == ND_ACTION_RX_ON)
+    {
+      on_at = schedule[i].offset;
+    }
+    else if (schedule[i].action == ND_ACTION_RX_OFF)
+    {
+      listen_full += schedule[i].offset - on_at;
+    }
+  }
+  return true;
+}
+
+/**
+ * Decides if the slot starting now is awake and advances the slot counters
+ */
+static void nd_slot_begin(void)
+{
+  bool extra = gossip_boost != 0 && slot_c3 == 0;
+
+  if (++slot_c3 == ND_GOSSIP_STRIDE)
+  {
+    slot_c3 = 0;
+  }
+  switch (nd_mode)
+  {
+  case ND_DISCO:
+    // awake every p1 and every p2 slots
+    slot_awake = slot_c1 == 0 || slot_c2 == 0;
+    if (++slot_c1 == ND_DISCO_P1)
+    {
+      slot_c1 = 0;
+    }
+    if (++slot_c2 == ND_DISCO_P2)
+    {
+      slot_c2 = 0;
+    }
+    break;
+  case ND_UCONNECT:
+    // awake every p slots and for (p + 1) / 2 slots every p * p slots
+    slot_awake = slot_c1 == 0 || slot_c2 < (ND_UCONNECT_P + 1) / 2;
+    if (++slot_c1 == ND_UCONNECT_P)
+    {
+      slot_c1 = 0;
+    }
+    if (++slot_c2 == ND_UCONNECT_P * ND_UCONNECT_P)
+    {
+      slot_c2 = 0;
+    }
+    break;
+  case ND_SEARCHLIGHT:
+    // anchor slot at the start of each period, probe slot moving by one slot
+    // each period through the first half of it
+    slot_awake = slot_c1 == 0 || slot_c1 == slot_c2;
+    if (++slot_c1 == ND_SEARCHLIGHT_T)
+    {
+      slot_c1 = 0;
+      if (++slot_c2 > ND_SEARCHLIGHT_T / 2)
+      {
+        slot_c2 = 1;
+      }
+    }
+    break;
+  }
+  slot_awake = slot_awake || extra;
+}
+
+/**
+ * Picks the channels of the epoch starting now and advances the counters.
+ * The beacons move to the next channel every epoch and the listens every
+ * round of the channels: whatever the phase between two nodes, the beacons
+ * of any round of one fall once on the channel the other keeps for a round,
+ * so that nodes meeting every epoch without hopping meet every round. The node id
+ * spreads the nodes that start together over the channels.
+ */
+static void nd_hop_next(void)
+{
+  hop_tx_channel = hop_channels[(hop_c + node_id) % ND_HOP_CHANNEL_COUNT];
+  hop_rx_channel = hop_channels[(hop_round + node_id) % ND_HOP_CHANNEL_COUNT];
+  if (++hop_c == ND_HOP_CHANNEL_COUNT)
+  {
+    hop_c = 0;
+    if (++hop_round == ND_HOP_CHANNEL_COUNT)
+    {
+      hop_round = 0;
+    }
+  }
+}
+
+/**
+ * Moves the radio to channel, if hopping
+ */
+static void nd_hop_to(uint8_t channel)
+{
+  if (hop && channel != hop_channel)
+  {
+    NETSTACK_RADIO.set_value(RADIO_PARAM_CHANNEL, channel);
+    hop_channel = channel;
+  }
+}
+
+/**
+ * Function called each end of epoch
+ */
+static void nd_step(void)
+{
+  if (epoch != 0)
+  {
+    ND_TRACE_FLUSH(epoch);
+
+    struct nd_rdc_stats rdc;
+    struct nd_epoch_stats *stats = &epoch_stats[epoch & 1];
+    nd_rdc_stats_reset(&rdc);
+    stats->listen_ticks = listen_ticks;
+    // the slotted modes do not adapt, their listening is the planned one
+    stats->listen_target = slots_per_epoch != 0 ? listen_ticks : listen_full >> listen_level;
+    stats->listen_level = listen_level;
+    stats->rendezvous = rendezvous_n;
+    stats->tx_sent = rdc.sent;
+    stats->tx_busy = rdc.busy;
+    stats->tx_collisions = rdc.collisions;
+    stats->tx_backoffs = rdc.backoffs;
+    stats->tx_dropped = rdc.dropped;
+    stats->rx_dropped = rx_dropped;
+    stats->tx_channel = hop ? hop_tx_channel : 0;
+    stats->rx_channel = hop ? hop_rx_channel : 0;
+    memcpy(stats->radio_tx, rdc.tx_ticks, sizeof(stats->radio_tx));
+    memcpy(stats->radio_rx, rdc.rx_ticks, sizeof(stats->radio_rx));
+    epoch_stats_epoch[epoch & 1] = epoch;
+  }
+
+  epoch++; // nd_process ends the previous epoch once it sees it
+  listen_ticks = 0;
+  rx_dropped = 0;
+  if (gossip)
+  {
+    nd_gossip_digest();
+  }
+  rdv_len = 0;
+  rdv_pos = 0;
+  rendezvous_n = 0;
+  if (rendezvous)
+  {
+    nd_rdv_plan();
+  }
+  if (hop)
+  {
+    nd_hop_next();
+  }
+
+  nd_log_write(ND_LOG_NCO, &collision_offset, 1);
+  process_poll(&nd_process);
+}
+
+/**
+ * Reports the end of nbr_epoch to the application and moves the neighbour
+ * table to the next epoch
+ */
+static void nd_epoch_end(void)
+{
+  app_cb.nd_epoch_end(nbr_epoch, discovered_n_epoch, discovered_n_epoch_new);
+  if (app_cb.nd_epoch_report != NULL)
+  {
+    struct nd_epoch_stats stats;
+    if (epoch_stats_epoch[nbr_epoch & 1] == nbr_epoch)
+    {
+      stats = epoch_stats[nbr_epoch & 1];
+    }
+    else
+    {
+      memset(&stats, 0, sizeof(stats)); // overwritten, nd_process lagged
+    }
+    stats.gossip_hits = gossip_hits;
+    stats.candidates = nd_gossip_pending();
+    app_cb.nd_epoch_report(nbr_epoch, &stats);
+  }
+  nd_listen_adapt();
+
+  nbr_epoch++;
+  gossip_hits = 0;
+  discovered_n_epoch = 0;
+  discovered_n_epoch_new = 0;
+
+  // neighbours seen in the new epoch are tracked by last_seen, only
+  // forget the stale ones
+  nd_nbr_age();
+  if (gossip)
+  {
+    nd_gossip_rotate();
+  }
+}
+
+/**
+ * Publishes a view of the neighbour table for the rtimer side
+ */
+static void nd_nbr_publish(void)
+{
+  uint8_t next = nbr_view_pub ^ 1;
+
+  if (gossip)
+  {
+    nd_gossip_view(&nbr_view[next]);
+  }
+  if (rendezvous)
+  {
+    nd_rdv_view(&nbr_view[next]);
+  }
+  nbr_view_pub = next; // publishes the view
+}
+
+/**
+ * Applies the queued beacons, ending the epochs in order with them
+ */
+static void nd_process_events(void)
+{
+  bool changed = false;
+
+  for (;;)
+  {
+    const struct nd_rx_event *ev = &rx_queue[rx_tail & ND_RX_QUEUE_MASK];
+    bool pending = rx_tail != rx_head;
+
+    if (pending && ev->epoch == nbr_epoch)
+    {
+      nd_rx_apply(ev);
+      rx_tail++;
+    }
+    else if (nbr_epoch != epoch)
+    {
+      nd_epoch_end();
+    }
+    else if (pending)
+    {
+      // heard in an epoch already ended, counts in this one
+      nd_rx_apply(ev);
+      rx_tail++;
+    }
+    else
+    {
+      break;
+    }
+    changed = true;
+  }
+  if (changed && (gossip || rendezvous))
+  {
+    nd_nbr_publish();
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(nd_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while (1)
+  {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    nd_process_events();
+  }
+
+  PROCESS_END();
+}
+
+/**
+ * Moves the schedule to its next period
+ */
+static void nd_schedule_rewind(void)
+{
+  epoch_start += epoch_duration;
+  if (slots_per_epoch != 0 && epoch_slot == 0)
+  {
+    epoch_start += ND_SLOT_PAD; // the epoch just ended
+  }
+  schedule_pos = 0;
+  collision_offset = TRANSMISSION_COLLISION_OFFSET;
+}
+
+/**
+ * Tells if an entry is not run in this slot or epoch
+ */
+static bool nd_schedule_skip(const struct nd_slot *slot)
+{
+  if ((slot->flags & ND_SLOT_AWAKE) && !slot_awake)
+  {
+    return true;
+  }
+  // window i is opened once every 2^listen_level epochs
+  return (slot->flags & ND_SLOT_ADAPT) && ((slot->flags >> 4) + epoch) & ((1u << listen_level) - 1);
+}
+
+/**
+ * Switches the radio as wanted by the schedule and the rendezvous, at is the
+ * offset of the action in the period
+ */
+static void nd_radio_update(rtimer_clock_t at)
+{
+  bool on = table_rx || rdv_rx;
+
+  if (on == radio_rx)
+  {
+    return;
+  }
+  radio_rx = on;
+  if (on)
+  {
+    NETSTACK_RDC.on();
+    rx_on_at = at;
+  }
+  else
+  {
+    NETSTACK_RDC.off(0);
+    listen_ticks += at - rx_on_at;
+  }
+}
+
+/**
+ * Offset of the next rendezvous action
+ */
+static rtimer_clock_t nd_rdv_at(void)
+{
+  return (rdv_pos & 1) ? rdv[rdv_pos >> 1].off : rdv[rdv_pos >> 1].on;
+}
+
+/**
+ * Offset of the current schedule entry
+ */
+static rtimer_clock_t nd_schedule_at(void)
+{
+  const struct nd_slot *slot = &schedule[schedule_pos];
+  rtimer_clock_t at = slot->offset;
+
+  if (slot->flags & ND_SLOT_JITTER)
+  {
+    at += collision_offset;
+  }
+  return at;
+}
+
+/**
+ * Runs the schedule entries, beacon retries and rendezvous actions that are
+ * already due, then arms the timer for the next one
+ */
+static void nd_schedule_run(void)
+{
+  for (;;)
+  {
+    rtimer_clock_t at = nd_schedule_at();
+    // a deferred beacon is always retried before the next entry
+    bool is_retry = tx_attempt != 0;
+    bool is_rdv;
+
+    if (is_retry)
+    {
+      at = tx_retry_at;
+    }
+    is_rdv = rdv_pos < 2 * rdv_len && nd_rdv_at() <= at;
+    if (is_rdv)
+    {
+      at = nd_rdv_at();
+      is_retry = false;
+    }
+    if (RTIMER_CLOCK_LT(RTIMER_NOW() + ND_SCHEDULE_MIN_DELAY, EPOCH_TICK(at)))
+    {
+      rtimer_set(&nd_timer, EPOCH_TICK(at), 0, nd_schedule_timeout, NULL);
+      return;
+    }
+
+    if (is_rdv)
+    {
+      ND_TRACE_RECORD(ND_TRACE_RDV, EPOCH_TICK(at));
+      rdv_rx = !(rdv_pos & 1);
+      nd_radio_update(at);
+      rdv_pos++;
+      continue;
+    }
+    if (is_retry)
+    {
+      ND_TRACE_RECORD(ND_TRACE_RETRY, EPOCH_TICK(at));
+      nd_send_beacon();
+      continue;
+    }
+
+    ND_TRACE_RECORD(schedule[schedule_pos].action, EPOCH_TICK(at));
+    nd_rdc_set_phase(schedule[schedule_pos].phase);
+    switch (schedule[schedule_pos].action)
+    {
+    case ND_ACTION_TX:
+      // the beacon has to be out before the next entry
+      tx_attempt = 1;
+      tx_deadline = schedule[schedule_pos + 1].offset;
+      nd_hop_to(hop_tx_channel);
+      nd_send_beacon();
+      break;
+    case ND_ACTION_RX_ON:
+      nd_hop_to(hop_rx_channel);
+      table_rx = true;
+      nd_radio_update(at);
+      break;
+    case ND_ACTION_RX_OFF:
+      table_rx = false;
+      nd_radio_update(at);
+      break;
+    case ND_ACTION_SLOT:
+      nd_slot_begin();
+      break;
+    case ND_ACTION_END:
+      // the slotted modes end the epoch once every slots_per_epoch periods
+      if (slots_per_epoch == 0 || ++epoch_slot == slots_per_epoch)
+      {
+        epoch_slot = 0;
+        nd_step();
+      }
+      nd_schedule_rewind();
+      schedule_pos--;
+      break;
+    }
+    schedule_pos++;
+    while (nd_schedule_skip(&schedule[schedule_pos]))
+    {
+      schedule_pos++;
+    }
+  }
+}
+
+static void nd_schedule_timeout(struct rtimer *t, void *ptr)
+{
+  nd_schedule_run();
+}
+
+/**
+ * Sets up a slotted mode, where the schedule covers a single slot
+ */
+static void nd_slotted_config(void)
+{
+  slots_per_epoch = ND_SLOTS_PER_EPOCH;
+  epoch_slot = 0;
+  adaptive = false; // the slot patterns give the discovery bound
+  rendezvous = false;
+  hop = false;
+  slot_c1 = 0;
+  slot_c2 = (nd_mode == ND_SEARCHLIGHT) ? 1 : 0;
+  epoch_duration = ND_SLOT_TICKS;
+  jitter_max = ND_SLOT_TICKS / 4;
+
+  uint32_t worst = 0;
+  switch (nd_mode)
+  {
+  case ND_DISCO:
+    worst = (uint32_t)ND_DISCO_P1 * ND_DISCO_P2;
+    break;
+  case ND_UCONNECT:
+    worst = (uint32_t)ND_UCONNECT_P * ND_UCONNECT_P;
+    break;
+  case ND_SEARCHLIGHT:
+    worst = (uint32_t)ND_SEARCHLIGHT_T * (ND_SEARCHLIGHT_T / 2);
+    break;
+  }
+  printf("ND: slot %u ticks, idle %u after the last one, worst case discovery %lu slots\n",
+         ND_SLOT_TICKS, ND_SLOT_PAD, (unsigned long)worst);
+
+  // the START line reports slots as windows, with two beacons each
+  TRANSMISSION_PER_WINDOW = 2;
+  TRANSMISSION_WINDOW_COUNT = ND_SLOTS_PER_EPOCH;
+  RECEPTION_WINDOW_COUNT = ND_SLOTS_PER_EPOCH;
+  WINDOW_LEN = ND_SLOT_TICKS;
+  TRANSMISSION_DURATION = ND_SLOT_TICKS - ND_BEACON_TICKS;
+  RECEPTION_DURATION = ND_SLOT_TICKS - ND_BEACON_TICKS;
+  RECEPTION_WINDOW_DURATION = ND_SLOT_TICKS;
+  TRANSMISSION_WINDOW_DURATION = ND_SLOT_TICKS;
+  FIRST_TRANSMIT = false;
+}
+
+/**
+ * Compiles the schedule, prints the configuration and starts the first
+ * epoch. Returns -1 if the schedule does not fit, 0 otherwise.
+ */
+static int nd_begin(const struct nd_callbacks *cb)
+{
+  unsigned i;
+
+  if (!nd_schedule_compile())
+  {
+    return -1;
+  }
+
+  // set reference of callbacks
+  app_cb.nd_new_nbr = cb->nd_new_nbr;
+  app_cb.nd_epoch_end = cb->nd_epoch_end;
+  app_cb.nd_epoch_report = cb->nd_epoch_report;
+  nd_log_init();
+
+  if (hop)
+  {
+    // its listens would have to be on the unknown channel of the neighbour
+    rendezvous = false;
+    for (i = 0; i < ND_HOP_CHANNEL_COUNT; i++)
+    {
+      if (hop_channels[i] < 11 || hop_channels[i] > 26)
+      {
+        printf("ND: channel %u not in 11..26, no hopping\n", hop_channels[i]);
+        hop = false;
+      }
+    }
+  }
+  hop_c = 0;
+  hop_round = 0;
+  hop_channel = 0;
+
+  memset(&beacon, 0, sizeof(beacon));
+  beacon.nid = (uint32_t) node_id;
+  beacon.offset = 0xFFFF;
+  beacon_len = gossip ? sizeof(struct beacon_msg) : rendezvous ? ND_BEACON_HDR_LEN : sizeof(uint32_t);
+  nd_rdc_beacon_changed();
+  memset(candidates, 0, sizeof(candidates));
+  gossip_boost = 0;
+
+  // init neighbours table
+  memset(nbr_table, 0, sizeof(nbr_table));
+  nbr_count = 0;
+  digest_slice = 0xFFFF;
+  memset(nbr_view, 0, sizeof(nbr_view));
+  nbr_view[0].slice = digest_slice;
+  nbr_view_pub = 0;
+
+  printf(
+      "START: %s, %d, %d, %d, %d, %d, %d, %d\n",
+      nd_mode_names[nd_mode],
+      TRANSMISSION_WINDOW_COUNT,
+      RECEPTION_WINDOW_COUNT,
+      TRANSMISSION_WINDOW_DURATION,
+      RECEPTION_WINDOW_DURATION,
+      TRANSMISSION_PER_WINDOW,
+      TRANSMISSION_DURATION,
+      RECEPTION_DURATION);
+  printf(
+      "START: TYPE, \
+        TRANSMISSION_WINDOW_COUNT, \
+        RECEPTION_WINDOW_COUNT, \
+        TRANSMISSION_WINDOW_DURATION, \
         RECEPTION_WINDOW_DURATION, \
         TRANSMISSION_PER_WINDOW, \
         TRANSMISSION_DURATION, \
         RECEPTION_DURATION\n");
-    nd_step(); // does the first step
+
+  if (adaptive)
+  {
+    printf("ND: adaptive listening, quiet epochs %u, max level %u\n",
+           ND_ADAPTIVE_QUIET_EPOCHS, ND_ADAPTIVE_MAX_LEVEL);
+  }
+  if (gossip)
+  {
+    printf("ND: gossip, digest of %u ids\n", ND_DIGEST_BITS);
+  }
+  if (rendezvous)
+  {
+    printf("ND: rendezvous, up to %u listens of %u ticks\n",
+           ND_RDV_MAX, (unsigned)(ND_RDV_TX_DELAY + ND_BEACON_TICKS + 2 * ND_RDV_GUARD));
+  }
+  if (hop)
+  {
+    printf("ND: hopping over %u channels:", (unsigned)ND_HOP_CHANNEL_COUNT);
+    for (i = 0; i < ND_HOP_CHANNEL_COUNT; i++)
+    {
+      printf(" %u", hop_channels[i]);
+    }
+    printf("\n");
+  }
+  listen_level = 0;
+  quiet_epochs = 0;
+
+  nd_step(); // does the first step
+  nbr_epoch = epoch;
+  gossip_hits = 0;
+  discovered_n_epoch = 0;
+  discovered_n_epoch_new = 0;
+  rx_tail = rx_head;
+  process_start(&nd_process, NULL);
+  epoch_start = RTIMER_NOW();
+  start_tick = epoch_start;
+  collision_offset = TRANSMISSION_COLLISION_OFFSET;
+  schedule_pos = 0;
+  tx_attempt = 0;
+  table_rx = false;
+  rdv_rx = false;
+  radio_rx = false;
+  nd_schedule_run();
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+void nd_start(uint8_t mode, const struct nd_callbacks *cb)
+{
+  /* Start seleced ND primitive and set nd_callbacks */
+
+  rendezvous = (mode & ND_RENDEZVOUS) != 0;
+  adaptive = (mode & ND_ADAPTIVE) != 0 || rendezvous;
+  gossip = (mode & ND_GOSSIP) != 0;
+  hop = (mode & ND_HOP) != 0;
+  mode &= ~(ND_ADAPTIVE | ND_GOSSIP | ND_RENDEZVOUS | ND_HOP);
+  nd_mode = mode;
+  slots_per_epoch = 0;
+  epoch_duration = EPOCH_DURATION;
+  jitter_max = ND_COLLISION_OFFSET_MAX;
+  switch (mode)
+  {
+  case ND_BURST:
+  {
+    // set settings for BURST primitive
+    TRANSMISSION_PER_WINDOW = TRANSMISSION_PER_WINDOW_BURST;
+    TRANSMISSION_WINDOW_COUNT = TRANSMISSION_WINDOW_COUNT_BURST;
+    RECEPTION_WINDOW_COUNT = RECEPTION_WINDOW_COUNT_BURST;
+    WINDOW_LEN = WINDOW_LEN_BURST;
+    TRANSMISSION_DURATION = TRANSMISSION_DURATION_BURST;
+    RECEPTION_DURATION = RECEPTION_DURATION_BURST;
+    RECEPTION_WINDOW_DURATION = RECEPTION_WINDOW_DURATION_BURST;
+    TRANSMISSION_WINDOW_DURATION = TRANSMISSION_WINDOW_DURATION_BURST;
+    FIRST_TRANSMIT = true;
+    if (RECEPTION_DURATION_BURST < TRANSMISSION_DURATION_BURST + ND_BEACON_TICKS)
+    {
+      printf("ND: BURST listens shorter than a beacon spacing, a beacon can miss a burst\n");
+    }
     break;
   }
   case ND_SCATTER:
@@ -460,27 +1846,166 @@ void nd_start(uint8_t mode, const struct nd_callbacks *cb)
     RECEPTION_WINDOW_DURATION = RECEPTION_WINDOW_DURATION_SCATTER;
     TRANSMISSION_WINDOW_DURATION = TRANSMISSION_WINDOW_DURATION_SCATTER;
     FIRST_TRANSMIT = false;
-    printf(
-        "START: SCATTER, %d, %d, %d, %d, %d, %d, %d\n",
-        TRANSMISSION_WINDOW_COUNT,
-        RECEPTION_WINDOW_COUNT,
-        TRANSMISSION_WINDOW_DURATION,
-        RECEPTION_WINDOW_DURATION,
-        TRANSMISSION_PER_WINDOW,
-        TRANSMISSION_DURATION,
-        RECEPTION_DURATION);
-    printf(
-        "START: TYPE, \
-        TRANSMISSION_WINDOW_COUNT, \
-        RECEPTION_WINDOW_COUNT, \
-        TRANSMISSION_WINDOW_DURATION, \
-        RECEPTION_WINDOW_DURATION, \
-        TRANSMISSION_PER_WINDOW, \
-        TRANSMISSION_DURATION, \
-        RECEPTION_DURATION\n");
-    nd_step(); // does the first step
     break;
   }
+  case ND_DISCO:
+  case ND_UCONNECT:
+  case ND_SEARCHLIGHT:
+    nd_slotted_config();
+    break;
+  default:
+    return;
+  }
+  nd_begin(cb);
+}
+
+/**
+ * BURST within budget ticks of radio on time per epoch. The burst must span
+ * its window and every listen must last a beacon spacing plus a beacon, so
+ * the number of reception windows is lowered until that fits the budget.
+ * Returns the radio on time of the chosen configuration.
+ */
+static uint32_t nd_budget_burst(uint32_t budget)
+{
+  int rx_windows = RECEPTION_WINDOW_COUNT_BURST;
+  rtimer_clock_t window = 0;
+  rtimer_clock_t spacing = 0;
+  uint32_t beacons = 0;
+  uint32_t listen = 0;
+
+  for (; rx_windows > 0; rx_windows--)
+  {
+    // what the schedule holds besides the beacons
+    uint32_t max_beacons = ND_SCHEDULE_MAX - nd_schedule_entries(true, 0, rx_windows);
+
+    window = epoch_duration / (TRANSMISSION_WINDOW_COUNT_BURST + rx_windows);
+    beacons = window / TRANSMISSION_DURATION_BURST;
+    if (beacons > max_beacons)
+    {
+      beacons = max_beacons;
+    }
+    if (beacons == 0)
+    {
+      beacons = 1;
+    }
+    spacing = window / beacons;
+
+    uint32_t tx = beacons * ND_BEACON_TICKS;
+    listen = budget > tx ? (budget - tx) / (rx_windows + 1) : 0;
+    // the last listen ends the epoch, it must not overlap the previous one
+    if (listen > window / 2)
+    {
+      listen = window / 2;
+    }
+    if (listen >= spacing + ND_BEACON_TICKS)
+    {
+      break;
+    }
+  }
+  if (rx_windows == 0)
+  {
+    // over budget: the cheapest configuration that still discovers, the
+    // beacons close enough for half a window to catch one
+    rx_windows = 1;
+    listen = spacing + ND_BEACON_TICKS;
+    if (listen > window / 2)
+    {
+      listen = window / 2;
+      beacons = (window + listen - ND_BEACON_TICKS - 1) / (listen - ND_BEACON_TICKS);
+      spacing = window / beacons;
+    }
+  }
+
+  TRANSMISSION_PER_WINDOW = beacons;
+  TRANSMISSION_WINDOW_COUNT = TRANSMISSION_WINDOW_COUNT_BURST;
+  RECEPTION_WINDOW_COUNT = rx_windows;
+  WINDOW_LEN = window;
+  TRANSMISSION_DURATION = spacing;
+  RECEPTION_DURATION = listen;
+  RECEPTION_WINDOW_DURATION = window;
+  TRANSMISSION_WINDOW_DURATION = window;
+  FIRST_TRANSMIT = true;
+  return (rx_windows + 1) * listen + beacons * ND_BEACON_TICKS;
+}
+
+/**
+ * SCATTER within budget ticks of radio on time per epoch. The reception
+ * window is as long as the beacon period, so the epoch is split in more and
+ * shorter windows until listening plus the beacons fit the budget.
+ * Returns the radio on time of the chosen configuration.
+ */
+static uint32_t nd_budget_scatter(uint32_t budget)
+{
+  // one window is spent listening, the others and the epoch boundary beacon
+  // transmit; the last split that fits the schedule is the cheapest
+  int windows = 2;
+  rtimer_clock_t window = 0;
+
+  for (;; windows++)
+  {
+    window = epoch_duration / windows;
+    if (window + (uint32_t)windows * ND_BEACON_TICKS <= budget ||
+        nd_schedule_entries(false, windows + 1 - RECEPTION_WINDOW_COUNT_SCATTER,
+                            RECEPTION_WINDOW_COUNT_SCATTER) > ND_SCHEDULE_MAX)
+    {
+      break;
+    }
+  }
+
+  TRANSMISSION_PER_WINDOW = 1;
+  TRANSMISSION_WINDOW_COUNT = windows - RECEPTION_WINDOW_COUNT_SCATTER;
+  RECEPTION_WINDOW_COUNT = RECEPTION_WINDOW_COUNT_SCATTER;
+  WINDOW_LEN = window;
+  TRANSMISSION_DURATION = window;
+  RECEPTION_DURATION = window;
+  RECEPTION_WINDOW_DURATION = window;
+  TRANSMISSION_WINDOW_DURATION = window;
+  FIRST_TRANSMIT = false;
+  return window + (uint32_t)windows * ND_BEACON_TICKS;
+}
+
+/*---------------------------------------------------------------------------*/
+int nd_start_with_budget(uint8_t mode, uint32_t target_duty_cycle_ppm,
+                         rtimer_clock_t epoch_ticks, const struct nd_callbacks *cb)
+{
+  uint32_t budget;
+  uint32_t on;
+
+  if (epoch_ticks == 0 || epoch_ticks > ND_EPOCH_TICKS_MAX || target_duty_cycle_ppm > 1000000)
+  {
+    printf("ND: invalid budget %lu ppm or epoch %lu ticks\n",
+           (unsigned long)target_duty_cycle_ppm, (unsigned long)epoch_ticks);
+    return -1;
+  }
+  epoch_duration = epoch_ticks;
+  budget = (uint32_t)(((uint64_t)target_duty_cycle_ppm * epoch_ticks) / 1000000);
+
+  rendezvous = (mode & ND_RENDEZVOUS) != 0;
+  adaptive = (mode & ND_ADAPTIVE) != 0 || rendezvous;
+  gossip = (mode & ND_GOSSIP) != 0;
+  hop = (mode & ND_HOP) != 0;
+  mode &= ~(ND_ADAPTIVE | ND_GOSSIP | ND_RENDEZVOUS | ND_HOP);
+  nd_mode = mode;
+  slots_per_epoch = 0;
+  jitter_max = ND_COLLISION_OFFSET_MAX;
+  switch (mode)
+  {
+  case ND_BURST:
+    on = nd_budget_burst(budget);
+    break;
+  case ND_SCATTER:
+    on = nd_budget_scatter(budget);
+    break;
+  default:
+    return -1;
+  }
+
+  printf("ND: budget %lu ppm, planned %lu ppm\n", (unsigned long)target_duty_cycle_ppm,
+         (unsigned long)(((uint64_t)on * 1000000) / epoch_ticks));
+  if (nd_begin(cb) < 0)
+  {
+    return -1;
   }
+  return on > budget;
 }
 /*---------------------------------------------------------------------------*/
@@ -1,32 +1,280 @@
+#ifndef ND_H
+#define ND_H
+
 /*---------------------------------------------------------------------------*/
 #define ND_BURST 1
 #define ND_SCATTER 2
+/* Slotted modes: the epoch is split in ND_SLOTS_PER_EPOCH slots and a node
+ * is awake only in some of them, which bounds the discovery latency. The
+ * ticks the slots leave of EPOCH_INTERVAL_RT are idle after the last one.
+ *  ND_DISCO: awake every ND_DISCO_P1 and every ND_DISCO_P2 slots (coprime),
+ *            discovery within P1 * P2 slots, duty cycle 1/P1 + 1/P2
+ *  ND_UCONNECT: awake every ND_UCONNECT_P slots and for (P + 1) / 2 slots
+ *            every P * P slots (P prime), discovery within P * P slots,
+ *            duty cycle (3P + 1) / 2P^2
+ *  ND_SEARCHLIGHT: anchor slot every ND_SEARCHLIGHT_T slots and a probe slot
+ *            sweeping the first half of the period, discovery within
+ *            T * (T / 2) slots, duty cycle 2/T
+ */
+#define ND_DISCO 3
+#define ND_UCONNECT 4
+#define ND_SEARCHLIGHT 5
+
+/* Flag for ND_BURST and ND_SCATTER: skip reception windows in rotation once
+ * the neighborhood is stable, see ND_ADAPTIVE_QUIET_EPOCHS */
+#define ND_ADAPTIVE 0x80
+
+/* Flag for all modes: beacons carry a digest of the sender's neighbors, and
+ * neighbors of neighbors not known yet make the node listen more, see
+ * ND_GOSSIP_BOOST_EPOCHS */
+#define ND_GOSSIP 0x40
+
+/* Flag for ND_BURST and ND_SCATTER: beacons carry their offset in the epoch,
+ * and the node listens briefly at the epoch start of each known neighbor
+ * while its blind reception windows back off as with ND_ADAPTIVE */
+#define ND_RENDEZVOUS 0x20
+
+/* Flag for ND_BURST and ND_SCATTER: hop over ND_HOP_CHANNELS, moving the
+ * beacons to the next channel every epoch and the listening to the next one
+ * every round of the channels, so that a neighbour's beacons are on the
+ * channel listened on once in each round. ND_RENDEZVOUS is turned off. */
+#define ND_HOP 0x10
 
 /*---------------------------------------------------------------------------*/
+/* Epoch length [rtimer ticks], at most 0x8000 */
+#ifdef ND_CONF_EPOCH_INTERVAL_RT
+#define EPOCH_INTERVAL_RT ND_CONF_EPOCH_INTERVAL_RT
+#else
 #define EPOCH_INTERVAL_RT (RTIMER_SECOND)
+#endif
+/*---------------------------------------------------------------------------*/
+#define MAX_NBR 64 /* Maximum number of neighbors, must be a power of 2 */
+
+/* Neighbors not heard for this many epochs are forgotten, 0 keeps them */
+#ifdef ND_CONF_NBR_MAX_AGE
+#define ND_NBR_MAX_AGE ND_CONF_NBR_MAX_AGE
+#else
+#define ND_NBR_MAX_AGE 0
+#endif
+
+/* Adaptive listening: after this many epochs without new neighbors only half
+ * of the reception windows are opened, then a quarter and so on down to one
+ * every 2^ND_ADAPTIVE_MAX_LEVEL (at most 16) epochs */
+#ifdef ND_CONF_ADAPTIVE_QUIET_EPOCHS
+#define ND_ADAPTIVE_QUIET_EPOCHS ND_CONF_ADAPTIVE_QUIET_EPOCHS
+#else
+#define ND_ADAPTIVE_QUIET_EPOCHS 5
+#endif
+
+#ifdef ND_CONF_ADAPTIVE_MAX_LEVEL
+#define ND_ADAPTIVE_MAX_LEVEL ND_CONF_ADAPTIVE_MAX_LEVEL
+#else
+#define ND_ADAPTIVE_MAX_LEVEL 2
+#endif
+
+/* Gossip: a newly advertised candidate gives ND_GOSSIP_BOOST_EPOCHS epochs at
+ * full listening rate, where the slotted modes are also awake every
+ * ND_GOSSIP_STRIDE slots. Up to ND_GOSSIP_CANDIDATES ids are remembered
+ * for ND_GOSSIP_RETRY epochs. */
+#ifdef ND_CONF_GOSSIP_BOOST_EPOCHS
+#define ND_GOSSIP_BOOST_EPOCHS ND_CONF_GOSSIP_BOOST_EPOCHS
+#else
+#define ND_GOSSIP_BOOST_EPOCHS 4
+#endif
+
+#ifdef ND_CONF_GOSSIP_STRIDE
+#define ND_GOSSIP_STRIDE ND_CONF_GOSSIP_STRIDE
+#else
+#define ND_GOSSIP_STRIDE 7
+#endif
+
+#ifdef ND_CONF_GOSSIP_CANDIDATES
+#define ND_GOSSIP_CANDIDATES ND_CONF_GOSSIP_CANDIDATES
+#else
+#define ND_GOSSIP_CANDIDATES 16
+#endif
+
+#ifdef ND_CONF_GOSSIP_RETRY
+#define ND_GOSSIP_RETRY ND_CONF_GOSSIP_RETRY
+#else
+#define ND_GOSSIP_RETRY 64
+#endif
+
+/* Rendezvous: at most ND_RDV_MAX neighbors heard in the last ND_RDV_MAX_AGE
+ * epochs get a listen in each epoch */
+#ifdef ND_CONF_RDV_MAX
+#define ND_RDV_MAX ND_CONF_RDV_MAX
+#else
+#define ND_RDV_MAX 16
+#endif
+
+#ifdef ND_CONF_RDV_MAX_AGE
+#define ND_RDV_MAX_AGE ND_CONF_RDV_MAX_AGE
+#else
+#define ND_RDV_MAX_AGE 4
+#endif
+
+/* Listen this long before and after the predicted start of a neighbour's
+ * epoch [rtimer ticks]. Its phase is tracked with a drift estimate, so the
+ * guard only has to cover the timestamp jitter and the error of the
+ * estimate over ND_RDV_MAX_AGE epochs, not the crystals' drift. */
+#ifdef ND_CONF_RDV_GUARD
+#define ND_RDV_GUARD ND_CONF_RDV_GUARD
+#else
+#define ND_RDV_GUARD (RTIMER_SECOND / 1000) /* 1 ms */
+#endif
+
+/* Channels ND_HOP goes through, 802.15.4 channels 11 to 26. The default ones
+ * are clear of Wi-Fi channels 1, 6 and 11. */
+#ifdef ND_CONF_HOP_CHANNELS
+#define ND_HOP_CHANNELS ND_CONF_HOP_CHANNELS
+#else
+#define ND_HOP_CHANNELS {15, 20, 25, 26}
+#endif
+
+/* Slotted modes parameters, the defaults give a duty cycle of about 5% */
+#ifdef ND_CONF_SLOTS_PER_EPOCH
+#define ND_SLOTS_PER_EPOCH ND_CONF_SLOTS_PER_EPOCH
+#else
+#define ND_SLOTS_PER_EPOCH 100 /* 10 ms slots */
+#endif
+
+#ifdef ND_CONF_DISCO_P1
+#define ND_DISCO_P1 ND_CONF_DISCO_P1
+#else
+#define ND_DISCO_P1 37
+#endif
+
+#ifdef ND_CONF_DISCO_P2
+#define ND_DISCO_P2 ND_CONF_DISCO_P2
+#else
+#define ND_DISCO_P2 43
+#endif
+
+#ifdef ND_CONF_UCONNECT_P
+#define ND_UCONNECT_P ND_CONF_UCONNECT_P
+#else
+#define ND_UCONNECT_P 31
+#endif
+
+#ifdef ND_CONF_SEARCHLIGHT_T
+#define ND_SEARCHLIGHT_T ND_CONF_SEARCHLIGHT_T
+#else
+#define ND_SEARCHLIGHT_T 40
+#endif
+
 /*---------------------------------------------------------------------------*/
-#define MAX_NBR 64 /* Maximum number of neighbors */
+/* Compile time check of a constant expression. Unlike #if, which computes in
+ * intmax_t, it is evaluated with the types of the target, where the tick
+ * constants can wrap at the 16 bits of an int. */
+#define ND_STATIC_ASSERT(cond, name) typedef char nd_static_assert_##name[(cond) ? 1 : -1]
 
+/*---------------------------------------------------------------------------*/
+/* Phases of the schedule, for the radio energy accounting:
+ *  ND_PHASE_IDLE: outside the windows and in the part of a reception window
+ *                 that is not listened, the radio is only on for rendezvous
+ *  ND_PHASE_TX: transmission windows
+ *  ND_PHASE_RX: listening part of the reception windows, awake slots
+ *  ND_PHASE_LAST: the listen that closes a BURST epoch
+ */
+#define ND_PHASE_IDLE 0
+#define ND_PHASE_TX 1
+#define ND_PHASE_RX 2
+#define ND_PHASE_LAST 3
+#define ND_PHASES 4
+
+/* Received beacons waiting for nd_process, a power of 2 */
+#ifdef ND_CONF_RX_QUEUE_LEN
+#define ND_RX_QUEUE_LEN ND_CONF_RX_QUEUE_LEN
+#else
+#define ND_RX_QUEUE_LEN 8
+#endif
+
+/* Log the tick, counted from nd_start(), at which each new neighbor was
+ * first heard, the start of frame of its beacon. Set ND_CONF_LATENCY to 0
+ * to leave it out. */
+#ifdef ND_CONF_LATENCY
+#define ND_LATENCY ND_CONF_LATENCY
+#else
+#define ND_LATENCY 1
+#endif
 /*---------------------------------------------------------------------------*/
 void nd_recv(void); /* Called by lower layers when a message is received */
 /*---------------------------------------------------------------------------*/
+/* Statistics of an epoch */
+struct nd_epoch_stats
+{
+  uint16_t listen_ticks;  /* radio listening time */
+  uint16_t listen_target; /* listening time planned at the current level */
+  uint8_t listen_level;   /* adaptive level, one window every 2^level opened */
+  uint8_t candidates;     /* gossip candidates still boosting listening */
+  uint8_t gossip_hits;    /* new neighbors that were gossip candidates */
+  uint8_t rendezvous;     /* rendezvous listens planned */
+  uint16_t tx_sent;       /* beacons on the air */
+  uint16_t tx_busy;       /* clear channel assessments that failed */
+  uint16_t tx_collisions; /* transmissions aborted by the radio */
+  uint16_t tx_backoffs;   /* beacons deferred by a random backoff */
+  uint16_t tx_dropped;    /* beacons given up, channel busy until too late */
+  uint16_t rx_dropped;    /* beacons lost, receive queue full */
+  uint8_t tx_channel;     /* channel of the beacons with ND_HOP, 0 otherwise */
+  uint8_t rx_channel;     /* channel listened on with ND_HOP, 0 otherwise */
+  uint16_t radio_tx[ND_PHASES]; /* transmitting in each phase [rtimer ticks] */
+  uint16_t radio_rx[ND_PHASES]; /* radio on otherwise in each phase [rtimer ticks] */
+};
+/*---------------------------------------------------------------------------*/
 /* ND callbacks:
  * 	nd_new_nbr: inform the application when a new neighbor is discovered
  *	nd_epoch_end: report to the application the number of neighbors discovered
  *				  at the end of the epoch
+ *	nd_epoch_report: optional, statistics of the epoch, called after nd_epoch_end
+ * They are called from nd_process, never from rtimer or radio context.
  */
 struct nd_callbacks
 {
-  void (*nd_new_nbr)(uint16_t epoch, uint8_t nbr_id);
+  void (*nd_new_nbr)(uint16_t epoch, uint16_t nbr_id);
 
   void (*nd_epoch_end)(uint16_t epoch, uint8_t num_nbr, uint8_t num_new_nbr);
+
+  void (*nd_epoch_report)(uint16_t epoch, const struct nd_epoch_stats *stats);
 };
 /*---------------------------------------------------------------------------*/
-/* Start selected ND primitive (ND_BURST or ND_SCATTER) */
+/* Neighbor record, kept for each discovered neighbor */
+struct nd_nbr
+{
+  uint16_t id;
+  uint16_t first_seen; /* epoch of the first beacon */
+  uint16_t last_seen;  /* epoch of the last beacon */
+  uint16_t beacons;    /* beacons received, saturates at 0xFFFF */
+  int8_t rssi;         /* RSSI of the last beacon, as given by the radio */
+  uint8_t lqi;         /* LQI of the last beacon */
+  uint16_t phase;      /* start of its epoch within ours with ND_RENDEZVOUS,
+                          0xFFFF if unknown [rtimer ticks] */
+  uint16_t phase_epoch; /* epoch the phase was measured in */
+  int16_t drift;        /* phase change per epoch [1/256 rtimer ticks] */
+};
+/*---------------------------------------------------------------------------*/
+/* Neighbor table queries. Records are returned in place, so pointers are only
+ * valid until the next beacon is received or the next epoch starts.
+ */
+const struct nd_nbr *nd_nbr_lookup(uint16_t nbr_id);
+const struct nd_nbr *nd_nbr_head(void);
+const struct nd_nbr *nd_nbr_next(const struct nd_nbr *nbr);
+uint8_t nd_nbr_count(void);
+/* Copies up to max records to dst, returns the number copied */
+uint8_t nd_nbr_snapshot(struct nd_nbr *dst, uint8_t max);
+/*---------------------------------------------------------------------------*/
+/* Start selected ND primitive (one of the ND_ modes above) */
 void nd_start(uint8_t mode, const struct nd_callbacks *cb);
+/* Start ND_BURST or ND_SCATTER with its windows derived at runtime, so that
+ * the radio is on for about target_duty_cycle_ppm parts per million of each
+ * epoch of epoch_ticks (at most 0x8000) rtimer ticks. The configuration is
+ * reported in the START line.
+ * Returns 0 if the target is met, 1 if it is too low and the cheapest
+ * configuration was started instead, -1 on invalid arguments or if its
+ * schedule does not fit.
+ */
+int nd_start_with_budget(uint8_t mode, uint32_t target_duty_cycle_ppm,
+                         rtimer_clock_t epoch_ticks, const struct nd_callbacks *cb);
 /*---------------------------------------------------------------------------*/
 
-void nd_stop_listen(void);
-void nd_listen(void);
-void nd_step();
-void nd_listen_last(void);
\ No newline at end of file
+#endif /* ND_H */
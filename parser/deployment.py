@@ -0,0 +1,130 @@
+"""Testbed deployment table, read from deployment.csv: the node id, the
+testbed name and the IEEE address of every node. parser.py resolves the
+testbed node names with it, and the zoul build generates deployment.c's
+table from it:
+
+    python3 parser/deployment.py deployment.csv > deployment-table.h
+
+The nodes are numbered by id order, their dense index. The generated table
+finds a node by id or by address in constant time through two perfect
+hashes, hash and displace: a key goes to a bucket, and the seed of the
+bucket is chosen so that the keys of all the buckets land in distinct
+slots. Keep the hashes in sync with deployment_slot() in deployment.c.
+"""
+import csv
+import hashlib
+import sys
+from os.path import abspath, dirname, join
+
+CSV = join(abspath(join(dirname(__file__), "..")), "deployment.csv")
+
+HASH_MUL = 0x9E3779B1  # odd, spreads the keys over the high bits
+SEED_MUL = 0x85EBCA6B
+MASK32 = 0xFFFFFFFF
+
+
+class Deployment:
+    def __init__(self, path=CSV):
+        with open(path, "rb") as f:
+            self.digest = hashlib.sha1(f.read()).hexdigest()[:16]  # of the content, for caches
+        with open(path, newline="") as f:
+            rows = sorted(csv.DictReader(f), key=lambda r: int(r["id"]))
+        self.ids = [int(r["id"]) for r in rows]
+        self.names = [r["name"] for r in rows]
+        self.addrs = [bytes.fromhex(r["ieee_addr"].replace(":", "")) for r in rows]
+        self.index = {nid: i for i, nid in enumerate(self.ids)}  # id -> dense index
+        self.by_name = {name: nid for name, nid in zip(self.names, self.ids)}
+        if len(self.index) != len(rows) or len(self.by_name) != len(rows) or 0 in self.index:
+            raise ValueError(f"{path}: ids and names must be unique, and ids not 0")
+        if any(len(a) != 8 for a in self.addrs):
+            raise ValueError(f"{path}: IEEE addresses must be 8 bytes")
+
+    def node_id(self, name) -> int:
+        """Node id of a testbed name, the number in it for the nodes not in
+        the table"""
+        nid = self.by_name.get(name)
+        return nid if nid is not None else int(name.rsplit(".", 1)[-1])
+
+
+def addr_key(addr: bytes) -> int:
+    """Hash key of an address, its last 4 bytes: the first ones are the
+    vendor's and the same for all the nodes"""
+    return int.from_bytes(addr[4:], "big")
+
+
+def slot(key, seed, slot_bits) -> int:
+    mixed = (key ^ (seed * SEED_MUL)) & MASK32
+    return ((mixed * HASH_MUL) & MASK32) >> (32 - slot_bits)
+
+
+def bucket(key, bucket_bits) -> int:
+    return ((key * HASH_MUL) & MASK32) >> (32 - bucket_bits)
+
+
+def perfect_hash(keys, slot_bits):
+    """Seeds of the buckets placing keys in distinct slots, each holding the
+    dense index + 1 of its key or 0; None if 8 bit seeds do not do"""
+    bucket_bits = max(slot_bits - 2, 1)
+    buckets = [[] for _ in range(1 << bucket_bits)]
+    for i, k in enumerate(keys):
+        buckets[bucket(k, bucket_bits)].append(i)
+    seeds = [0] * len(buckets)
+    slots = [0] * (1 << slot_bits)
+    # the largest buckets first, while there is room
+    for b in sorted(range(len(buckets)), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            break
+        for seed in range(256):
+            s = [slot(keys[i], seed, slot_bits) for i in buckets[b]]
+            if len(set(s)) == len(s) and not any(slots[x] for x in s):
+                break
+        else:
+            return None
+        seeds[b] = seed
+        for i, x in zip(buckets[b], s):
+            slots[x] = i + 1
+    return bucket_bits, seeds, slots
+
+
+def c_array(name, values, per_line=16) -> str:
+    lines = [", ".join(str(v) for v in values[i:i + per_line]) for i in range(0, len(values), per_line)]
+    return f"static const uint8_t {name}[{len(values)}] = {{\n    " + ",\n    ".join(lines) + "};\n"
+
+
+def c_table(d: Deployment) -> str:
+    """Text of deployment-table.h"""
+    if len(d.ids) > 254:
+        raise ValueError("at most 254 nodes, the slots hold the index + 1 in 8 bits")
+    addr_keys = [addr_key(a) for a in d.addrs]
+    if len(set(addr_keys)) != len(addr_keys):
+        raise ValueError("two addresses end with the same 4 bytes")
+
+    # the smallest table both hashes fit, at least a quarter empty
+    slot_bits = max(len(d.ids) + len(d.ids) // 3, 1).bit_length()
+    while True:
+        by_id = perfect_hash(d.ids, slot_bits)
+        by_addr = perfect_hash(addr_keys, slot_bits)
+        if by_id and by_addr:
+            break
+        slot_bits += 1
+
+    out = ["/* Generated by parser/deployment.py from deployment.csv, do not edit */\n",
+           f"#define DEPLOYMENT_NUM_NODES {len(d.ids)}\n",
+           f"#define DEPLOYMENT_SLOT_BITS {slot_bits}\n",
+           f"#define DEPLOYMENT_BUCKET_BITS {by_id[0]}\n",
+           f"#define DEPLOYMENT_HASH_MUL 0x{HASH_MUL:08X}u\n",
+           f"#define DEPLOYMENT_SEED_MUL 0x{SEED_MUL:08X}u\n\n",
+           "/* In dense index order */\n",
+           "static const struct id_addr deployment_id_addr_list[DEPLOYMENT_NUM_NODES] = {\n"]
+    for nid, name, addr in zip(d.ids, d.names, d.addrs):
+        out.append(f"    {{{nid}, {{{', '.join(f'0x{b:02X}' for b in addr)}}}}}, /* {name} */\n")
+    out.append("};\n\n/* Seeds of the buckets, and dense index + 1 of the key in each slot */\n")
+    out.append(c_array("deployment_id_seed", by_id[1]))
+    out.append(c_array("deployment_id_slot", by_id[2]))
+    out.append(c_array("deployment_addr_seed", by_addr[1]))
+    out.append(c_array("deployment_addr_slot", by_addr[2]))
+    return "".join(out)
+
+
+if __name__ == "__main__":
+    sys.stdout.write(c_table(Deployment(sys.argv[1] if len(sys.argv) > 1 else CSV)))
@@ -1,13 +1,25 @@
+import hashlib
+import json
 import math
+import os
 import re
+from concurrent.futures import ProcessPoolExecutor
 from datetime import datetime
-from os.path import join
+from os.path import basename, dirname, join
 
 import matplotlib.pyplot as plt
 import numpy as np
 
+import deployment
+
 FILENAME = "test.log"
 LOGS_FOLDER = "logs"
+CACHE_FOLDER = ".cache"  # next to each log, see load_cache()
+
+# Bump when a change to the parsing alters what is cached
+PARSER_VERSION = 5
+
+RTIMER_SECOND = 32768  # sky and zoul alike
 
 # Select cooja or testbed files
 if False:
@@ -32,19 +44,64 @@ else:
     ]
 
 
-class Node:
-    node_id: int = -1
-    neighbours = None
-    neighbour_count = 0
-    duty_cycle = 0
+# Text of the nd-log record types (nd-log.h) and the mask of their signed values
+ND_LOG_FORMATS = [
+    ("ND: log dropped {}", 0),
+    ("App: Epoch {} New NBR {}", 0),
+    ("App: Epoch {} finished Num NBR {} Num new NBR {}", 0),
+    ("App: Epoch {} listen {} target {} level {} candidates {} hits {}", 0),
+    ("App: Epoch {} tx {} busy {} collisions {} backoffs {} dropped {} rx dropped {}", 0),
+    ("App: Epoch {} radio idle {} {} tx {} {} rx {} {} last {} {}", 0),
+    ("NCO: {}", 0),
+    ("ND: late epoch {} n {} min {} max {} p99 {}", 0x0C),
+    ("ND: trace {} at {} late {}", 0x04),
+    ("ND: Epoch {} heard {} at {} {}", 0),
+    ("App: Epoch {} hop tx {} rx {}", 0),
+]
+
+
+ND_LOG_REGEX = re.compile(r"NDL:([0-9a-f]*)")
+
+
+def decode_nd_log(line):
+    """Expands an "NDL:<hex>" line into the text lines of its records, keeping
+    what surrounds the hex (log time, node id, testbed quoting)"""
+    if "NDL:" not in line:
+        return [line]
+    m = ND_LOG_REGEX.search(line)
+    if not m:
+        return [line]
+
+    prefix = line[:m.start()]
+    suffix = line[m.end():]
+    data = bytes.fromhex(m.group(1))
+    lines = []
+    i = 0
+    while i + 2 <= len(data):
+        rtype, n = data[i], data[i + 1]
+        values = [int.from_bytes(data[i + 2 + 2 * k:i + 4 + 2 * k], "little") for k in range(n)]
+        i += 2 + 2 * n
+        if rtype >= len(ND_LOG_FORMATS):
+            continue
+        fmt, signed = ND_LOG_FORMATS[rtype]
+        values = [v - 0x10000 if (signed >> k) & 1 and v >= 0x8000 else v for k, v in enumerate(values)]
+        lines.append(prefix + fmt.format(*values) + suffix)
+    return lines
+
+
+def expand_nd_log(f):
+    for line in f:
+        yield from decode_nd_log(line)
 
-    n_count_epoch: list  # n discovered each epoch
-    n_new_count_epoch: list  # n new neighbour discovered each epoch
 
-    def __init__(self):
-        self.n_count_epoch = [0 for i in range(1000)]
-        self.n_new_count_epoch = [0 for i in range(1000)]
-        self.neighbours = []
+# Phases of the ND schedule, in the order of the "radio" lines
+PHASES = ["idle", "tx", "rx", "last"]
+
+# Channel access counters of the "tx" lines, and the columns per channel
+# with ND_HOP: epochs and counters on it as tx channel, epochs, neighbours
+# heard and new neighbours on it as rx channel
+ACCESS = ["sent", "busy", "collisions", "backoffs", "dropped"]
+CHANNEL_COLUMNS = ["channel", "tx_epochs"] + ACCESS + ["rx_epochs", "heard", "new"]
 
 
 class Experiment:
@@ -61,12 +118,38 @@ class Experiment:
     epochs: list
 
     TRUNC_EP_LOW = 0
-    TRUNC_EP_HIGH = 100
+    TRUNC_EP_HIGH = 100  # 0 keeps every epoch
+
+    # Nodes are the ones that reported a new neighbour, one row each in
+    # node id order; epochs are the columns of the TRUNC_EP_* window
+    node_ids: np.ndarray
+    node_index: dict  # node id -> row
+    neighbours: list  # row -> ids of the neighbours, in discovery order
+    neighbour_count: np.ndarray
+    n_count_epoch: np.ndarray  # node x epoch, n discovered each epoch
+    n_new_count_epoch: np.ndarray  # node x epoch, n new neighbour discovered each epoch
+    duty_cycle: np.ndarray
+    epoch_counts: dict  # (node id, epoch) -> (n, n new) while parsing
 
-    nodes: list[Node]
     max_node_id = 0
     max_epoch = 0
     data_energest: dict
+    data_phase: dict  # node id -> radio ticks [tx, rx] of each phase, summed over the epochs
+    phase_epochs: dict  # node id -> number of epochs reported
+    start_time: dict  # node id -> time of its START line [s]
+    heard: dict  # (node id, neighbour id) -> first heard, ticks since the node's nd_start()
+    tx_counts: dict  # (node id, epoch) -> ACCESS counters, while parsing
+    hop_channels: dict  # (node id, epoch) -> (tx channel, rx channel), while parsing
+
+    # Channel access, from the "tx" lines, and per channel with ND_HOP
+    access: np.ndarray  # node epochs reported, then the ACCESS counters summed
+    channels: np.ndarray  # one row per channel, CHANNEL_COLUMNS
+
+    # Pairwise discovery latency, from the "heard" lines (ND_LATENCY)
+    latency_pairs: np.ndarray  # (node id, neighbour id) of each discovery
+    latency: np.ndarray  # seconds from both nodes started to the discovery
+    asymmetric_pairs: int  # node pairs where only one heard the other
+    linked_pairs: int  # node pairs where at least one heard the other
 
     dc_mean: float
 
@@ -74,58 +157,90 @@ class Experiment:
     testbed_job_id = 0
 
     def __init__(self):
-        self.nodes = []
+        self.node_index = {}
+        self.neighbours = []
+        self.epoch_counts = {}
         self.data_energest = {}
+        self.data_phase = {}
+        self.phase_epochs = {}
+        self.start_time = {}
+        self.heard = {}
+        self.tx_counts = {}
+        self.hop_channels = {}
+
+    def add_neighbour(self, node_id, n_discovered):
+        row = self.node_index.get(node_id)
+        if row is None:
+            row = self.node_index[node_id] = len(self.neighbours)
+            self.neighbours.append([])
+        if n_discovered not in self.neighbours[row]:
+            self.neighbours[row].append(n_discovered)
+
+    def collect_channels(self):
+        """Sums the channel access counters, and per channel the epochs each
+        was used in with what was sent and heard on it"""
+        counts = np.array(list(self.tx_counts.values()), dtype=np.int64).reshape(-1, len(ACCESS))
+        self.access = np.concatenate([[len(counts)], counts.sum(axis=0)])
+
+        rows = {}
+        for key, (tx, rx) in self.hop_channels.items():
+            for ch in (tx, rx):
+                if ch not in rows:
+                    rows[ch] = [ch] + [0] * (len(CHANNEL_COLUMNS) - 1)
+            access = self.tx_counts.get(key)
+            if access is not None:
+                rows[tx][1] += 1
+                rows[tx][2:2 + len(ACCESS)] = [a + b for a, b in zip(rows[tx][2:2 + len(ACCESS)], access)]
+            n = self.epoch_counts.get(key)
+            if n is not None:
+                rows[rx][-3] += 1
+                rows[rx][-2] += n[0]
+                rows[rx][-1] += n[1]
+        self.channels = np.array([rows[ch] for ch in sorted(rows)], dtype=np.int64).reshape(-1, len(CHANNEL_COLUMNS))
+        self.tx_counts = {}
+        self.hop_channels = {}
 
     def clear_empty_nodes(self):
-        self.nodes.pop(0)  # first element is always absent
-
-        tmp = self.nodes.copy()
-
-        self.nodes = []
-
-        for i in tmp:
-            if i.node_id != -1:
-                self.nodes.append(i)
-
-        # self.nodes = self.nodes[0:i]
-
-        for n in self.nodes:
-            n.neighbour_count = len(n.neighbours)
-
-        for n in self.nodes:
-            try:
-                while len(n.n_count_epoch) != self.max_epoch:
-                    n.n_count_epoch.pop(-1)
-
-                while len(n.n_new_count_epoch) != self.max_epoch:
-                    n.n_new_count_epoch.pop(-1)
-            except IndexError:
-                pass
-
-            n.n_count_epoch = n.n_count_epoch[self.TRUNC_EP_LOW:self.TRUNC_EP_HIGH]
-            n.n_new_count_epoch = n.n_new_count_epoch[self.TRUNC_EP_LOW:self.TRUNC_EP_HIGH]
-
-        self.epochs = [i for i in range(self.TRUNC_EP_LOW, self.TRUNC_EP_HIGH)]
+        """Builds the node x epoch arrays from what was read. Only the epochs
+        before max_epoch are kept, then the TRUNC_EP_* window of them."""
+        ids = sorted(self.node_index)
+        self.neighbours = [self.neighbours[self.node_index[nid]] for nid in ids]
+        self.node_ids = np.array(ids, dtype=np.int64)
+        self.node_index = {nid: row for row, nid in enumerate(ids)}
+        self.neighbour_count = np.array([len(n) for n in self.neighbours], dtype=np.int64)
+        self.duty_cycle = np.zeros(len(ids))
+
+        low = self.TRUNC_EP_LOW
+        high = min(self.max_epoch, self.TRUNC_EP_HIGH) if self.TRUNC_EP_HIGH else self.max_epoch
+        width = max(high - low, 0)
+        self.n_count_epoch = np.zeros((len(ids), width), dtype=np.int64)
+        self.n_new_count_epoch = np.zeros((len(ids), width), dtype=np.int64)
+
+        if self.epoch_counts and len(ids) != 0:
+            keys = np.array(list(self.epoch_counts.keys()), dtype=np.int64)
+            values = np.array(list(self.epoch_counts.values()), dtype=np.int64)
+            rows = np.minimum(np.searchsorted(self.node_ids, keys[:, 0]), len(ids) - 1)
+            keep = (self.node_ids[rows] == keys[:, 0]) & (keys[:, 1] >= low) & (keys[:, 1] < high)
+            self.n_count_epoch[rows[keep], keys[keep, 1] - low] = values[keep, 0]
+            self.n_new_count_epoch[rows[keep], keys[keep, 1] - low] = values[keep, 1]
+        self.epoch_counts = {}
+
+        self.epochs = [i for i in range(low, low + width)]
 
     def calculate_values(self):
 
-        arrays = []
-        arrays_new = []
-        for n in self.nodes:
-            arrays.append(n.n_count_epoch)
-            arrays_new.append(n.n_new_count_epoch)
+        others = len(self.node_ids) - 1  # neighbours a node can discover
 
-        self.avg_n_count_epoch = np.mean(arrays, axis=0)
-        self.avg_n_count_epoch_norm = self.avg_n_count_epoch / (self.max_node_id - 1)
+        self.avg_n_count_epoch = self.n_count_epoch.mean(axis=0)
+        self.avg_n_count_epoch_norm = self.avg_n_count_epoch / others
 
-        self.avg_n_count_epoch_overall = np.mean(arrays, axis=None)
-        self.avg_n_count_epoch_overall_percentage = self.avg_n_count_epoch_overall / (self.max_node_id - 1)
+        self.avg_n_count_epoch_overall = self.n_count_epoch.mean()
+        self.avg_n_count_epoch_overall_percentage = self.avg_n_count_epoch_overall / others
 
-        self.avg_n_new_count_epoch = np.mean(arrays_new, axis=0)
-        self.avg_n_new_count_epoch_norm = self.avg_n_new_count_epoch / (self.max_node_id - 1)
+        self.avg_n_new_count_epoch = self.n_new_count_epoch.mean(axis=0)
+        self.avg_n_new_count_epoch_norm = self.avg_n_new_count_epoch / others
 
-        self.name = f"{"cooja" if not self.is_testbed else "testbed"}_{self.TYPE}_{self.max_node_id}"
+        self.name = f"{'cooja' if not self.is_testbed else 'testbed'}_{self.TYPE}_{self.max_node_id}"
 
     def calculate_energest(self):
         dc_lst = []
@@ -140,7 +255,8 @@ class Experiment:
 
             dc = 100 * total_radio / total_time
             dc_lst.append(dc)
-            self.nodes[nid - 1].duty_cycle = dc
+            if nid in self.node_index:
+                self.duty_cycle[self.node_index[nid]] = dc
 
             print("Node {}:  Duty Cycle: {:.3f}%".format(nid, dc))
 
@@ -156,6 +272,80 @@ class Experiment:
                                                             dc_max))
 
 
+    def calculate_phase_energy(self):
+        """Radio time of each ND phase, from the per-epoch "radio" lines"""
+        if not self.data_phase:
+            return
+
+        totals = [0] * (2 * len(PHASES))
+        epochs = 0
+        for nid, v in self.data_phase.items():
+            totals = [a + b for a, b in zip(totals, v)]
+            epochs += self.phase_epochs[nid]
+        radio = sum(totals)
+
+        print("\n----- Radio Time per Phase (ticks per epoch) -----\n")
+        for i, name in enumerate(PHASES):
+            tx = totals[2 * i] / epochs
+            rx = totals[2 * i + 1] / epochs
+            share = 100 * (totals[2 * i] + totals[2 * i + 1]) / radio if radio else 0
+            print("{:5s} tx: {:8.1f}  rx: {:8.1f}  share: {:.1f}%".format(name, tx, rx, share))
+
+
+    def calculate_channels(self):
+        """Channel access per node and epoch, and per channel with ND_HOP"""
+        epochs = self.access[0]
+        if epochs == 0:
+            return
+        print("\n----- Channel Access (per node and epoch) -----\n")
+        print("  ".join("{}: {:.3f}".format(name, v / epochs) for name, v in zip(ACCESS, self.access[1:])))
+        if len(self.channels) == 0:
+            return
+        print("\n----- Channels -----\n")
+        print("{:>7s} {:>9s} {:>8s} {:>8s} {:>10s} {:>9s} {:>8s} {:>6s}".format(
+            "channel", "tx epochs", "sent/ep", "busy/ep", "coll./ep", "rx epochs", "heard/ep", "new"))
+        for ch, tx_epochs, sent, busy, coll, _, _, rx_epochs, heard, new in self.channels.tolist():
+            print("{:7d} {:9d} {:8.2f} {:8.2f} {:10.3f} {:9d} {:8.2f} {:6d}".format(
+                ch, tx_epochs, sent / max(tx_epochs, 1), busy / max(tx_epochs, 1), coll / max(tx_epochs, 1),
+                rx_epochs, heard / max(rx_epochs, 1), new))
+
+    def calculate_latency(self):
+        """Per pair latency of the first discovery, counted from the time
+        both nodes were running, its CDF and the links heard one way only"""
+        pairs = sorted(self.heard)
+        self.latency_pairs = np.array(pairs, dtype=np.int64).reshape(-1, 2)
+        self.latency = np.zeros(len(pairs))
+        for i, (nid, nbr) in enumerate(pairs):
+            self.latency[i] = self.heard[(nid, nbr)] / RTIMER_SECOND
+            if nid in self.start_time and nbr in self.start_time:
+                # the neighbour may have started after the node
+                self.latency[i] -= max(self.start_time[nbr] - self.start_time[nid], 0)
+        links = {(min(p), max(p)) for p in pairs}
+        self.linked_pairs = len(links)
+        self.asymmetric_pairs = sum(1 for a, b in links if (a, b) not in self.heard or (b, a) not in self.heard)
+
+        if len(pairs) == 0:
+            return
+        q = np.percentile(self.latency, [50, 90, 99])
+        print("\n----- Discovery Latency -----\n")
+        print("Pairs: {}  median: {:.3f}s  p90: {:.3f}s  p99: {:.3f}s  max: {:.3f}s".format(
+            len(pairs), q[0], q[1], q[2], self.latency.max()))
+        print("Links heard one way only: {}/{}".format(self.asymmetric_pairs, self.linked_pairs))
+
+    def latency_cdf(self):
+        """Sorted latencies and the fraction of pairs discovered by each"""
+        x = np.sort(self.latency)
+        return x, np.arange(1, len(x) + 1) / len(x)
+
+
+def log_time(e: Experiment, t) -> float:
+    """Time of a log line [s]: testbed lines carry the date, cooja and sim
+    lines the microseconds since the start"""
+    if e.is_testbed:
+        return datetime.strptime(t, '%Y-%m-%d %H:%M:%S,%f').timestamp()
+    return int(t) / 1e6 if t.isdigit() else None
+
+
 def save_output(e: Experiment):
     OUT_FILENAME = "testbed_" if e.is_testbed else "cooja_"
     OUT_FILENAME += f"{e.TYPE}_{e.max_node_id}.log"
@@ -167,139 +357,270 @@ def save_output(e: Experiment):
         output_f.write(line)
 
 
-def parse(filename=FILENAME, log_file=False, printinfo=False) -> Experiment:
+# Line patterns, compiled once. Each one is only tried on the lines holding
+# its key, a plain substring test that rules out most lines cheaply.
+REGEX_CHECK_TESTBED = re.compile(r"INFO:testbed-run:\sStart\stest\s(\d+)")
+
+_record_pattern = r"(?P<time>[\w:.]+)\s+ID:(?P<self_id>\d+)\s+"
+_testbed_record_pattern = r"\[(?P<time>.{23})\] INFO:(?P<self_id>firefly\.\d+): \d+\.firefly < b"
+_phase_pattern = r"App: Epoch (?P<epoch>\d+) radio idle (\d+) (\d+) tx (\d+) (\d+) rx (\d+) (\d+) last (\d+) (\d+)"
+_heard_pattern = r"ND: Epoch \d+ heard (?P<nbr>\d+) at (?P<low>\d+) (?P<high>\d+)"
+_tx_pattern = (r"App: Epoch (?P<epoch>\d+) tx (\d+) busy (\d+) collisions (\d+) backoffs (\d+) dropped (\d+)"
+               r" rx dropped \d+")
+_hop_pattern = r"App: Epoch (?P<epoch>\d+) hop tx (?P<tx>\d+) rx (?P<rx>\d+)"
+
+COOJA_REGEX = {
+    "settings": re.compile(r"\d+\sID:(\d+)\sSTART:\s(.+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+)"),
+    "new_n": re.compile(r"\d+\sID:(\d+)\sApp:\sEpoch\s(\d+)\sNew\sNBR\s(\d+)"),
+    "epoch_end": re.compile(r"\d+\sID:(\d+)\sApp:\sEpoch\s(\d+)\sfinished\sNum\sNBR\s(\d+)\sNum\snew\sNBR\s(\d+)"),
+    "dc": re.compile(r"{}Energest: (?P<cnt>\d+) (?P<cpu>\d+) "
+                     r"(?P<lpm>\d+) (?P<tx>\d+) (?P<rx>\d+)".format(_record_pattern)),
+    "phase": re.compile(_record_pattern + _phase_pattern),
+    "start": re.compile(_record_pattern + "START: "),
+    "heard": re.compile(_record_pattern + _heard_pattern),
+    "tx": re.compile(_record_pattern + _tx_pattern),
+    "hop": re.compile(_record_pattern + _hop_pattern),
+}
+
+TESTBED_REGEX = {
+    "settings": re.compile(r"INFO:(firefly.\d+):\s\d+.firefly\s<\sb'START:\s(.+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+)"),
+    "new_n": re.compile(r"INFO:(firefly.\d+):\s\d+.firefly\s<\sb'App:\sEpoch\s(\d+)\sNew\sNBR\s(\d+)"),
+    "epoch_end": re.compile(r"INFO:(firefly.\d+):\s\d+.firefly\s<\sb'App:\sEpoch\s(\d+)\sfinished\sNum\sNBR\s(\d+)\sNum\snew\sNBR\s(\d+)"),
+    "dc": re.compile(r"{}'Energest: (?P<cnt>\d+) (?P<cpu>\d+) "
+                     r"(?P<lpm>\d+) (?P<tx>\d+) (?P<rx>\d+)'".format(_testbed_record_pattern)),
+    "phase": re.compile(_testbed_record_pattern + "'" + _phase_pattern),
+    "start": re.compile(_testbed_record_pattern + "'START: "),
+    "heard": re.compile(_testbed_record_pattern + "'" + _heard_pattern),
+    "tx": re.compile(_testbed_record_pattern + "'" + _tx_pattern),
+    "hop": re.compile(_testbed_record_pattern + "'" + _hop_pattern),
+}
+
+
+DEPLOYMENT = deployment.Deployment()
+
+
+def testbed_node_id(name) -> int:
+    """Node id of a testbed node name, from deployment.csv"""
+    return DEPLOYMENT.node_id(name)
+
+
+def parse_lines(filename) -> Experiment:
+    """Reads a log into an Experiment, up to clear_empty_nodes()"""
     e = Experiment()
-    e.nodes = [Node() for i in range(1, 1000)]
     settings_found = False
+    regex = COOJA_REGEX
+    node = int  # node id of what the lines name the node with
+
+    with open(filename, "r") as f:
+        for c, line in enumerate(expand_nd_log(f)):
+            if c == 0:
+                m = REGEX_CHECK_TESTBED.search(line)
+                if m:
+                    e.is_testbed = True
+                    e.testbed_job_id = int(m.group(1))
+                    regex = TESTBED_REGEX
+                    node = testbed_node_id
+
+            if "START:" in line:
+                m = regex["start"].match(line)
+                if m and node(m.group('self_id')) not in e.start_time:
+                    t = log_time(e, m.group('time'))
+                    if t is not None:
+                        e.start_time[node(m.group('self_id'))] = t
+
+            if not settings_found and "START:" in line:
+                m = regex["settings"].search(line)
+
+                if m:
+                    e.TYPE = m.group(2)
+                    e.TRANSMISSION_WINDOW_COUNT = m.group(3)
+                    e.RECEPTION_WINDOW_COUNT = m.group(4)
+                    e.TRANSMISSION_WINDOW_DURATION = m.group(5)
+                    e.RECEPTION_WINDOW_DURATION = m.group(6)
+                    e.TRANSMISSION_PER_WINDOW = m.group(7)
+                    e.TRANSMISSION_DURATION = m.group(8)
+                    e.RECEPTION_DURATION = m.group(9)
+                    settings_found = True
+
+            if "New NBR" in line:
+                match = regex["new_n"].search(line)
+                if match:
+                    node_id = node(match.group(1))
+                    epoch = int(match.group(2))
+                    n_discovered = int(match.group(3))
+
+                    if node_id > e.max_node_id:
+                        e.max_node_id = node_id
+
+                    e.add_neighbour(node_id, n_discovered)
+
+                    e.max_epoch = max(e.max_epoch, epoch)
+
+            elif "finished" in line:
+                finish_match = regex["epoch_end"].search(line)
+                if finish_match:
+                    node_id = node(finish_match.group(1))
+                    epoch = int(finish_match.group(2))
 
-    f = open(filename, "r")
-
-    pattern_check_testbed = "INFO:testbed-run:\sStart\stest\s(\d+)"
-
-    # Cooja patterns
-    cooja_patter_settings = "\d+\sID:(\d+)\sSTART:\s(.+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+)"
-    cooja_pattern_new_n = "\d+\sID:(\d+)\sApp:\sEpoch\s(\d+)\sNew\sNBR\s(\d+)"
-    cooja_pattern_epoch_end = "\d+\sID:(\d+)\sApp:\sEpoch\s(\d+)\sfinished\sNum\sNBR\s(\d+)\sNum\snew\sNBR\s(\d+)"
-    record_pattern = r"(?P<time>[\w:.]+)\s+ID:(?P<self_id>\d+)\s+"
-    cooja_regex_dc = re.compile(r"{}Energest: (?P<cnt>\d+) (?P<cpu>\d+) "
-                                r"(?P<lpm>\d+) (?P<tx>\d+) (?P<rx>\d+)".format(record_pattern))
+                    n_count_discovered = int(finish_match.group(3))
+                    n_count_discovered_new = int(finish_match.group(4))  # new discovered
 
-    # Testbed patterns
-    testbed_pattern_settings = "INFO:firefly.(\d+):\s\d+.firefly\s<\sb'START:\s(.+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+),\s(\d+)"
-    testbed_pattern_new_n = "INFO:firefly.(\d+):\s\d+.firefly\s<\sb'App:\sEpoch\s(\d+)\sNew\sNBR\s(\d+)"
-    testbed_pattern_epoch_end = "INFO:firefly.(\d+):\s\d+.firefly\s<\sb'App:\sEpoch\s(\d+)\sfinished\sNum\sNBR\s(\d+)\sNum\snew\sNBR\s(\d+)"
-    testbed_record_pattern = r"\[(?P<time>.{23})\] INFO:firefly\.(?P<self_id>\d+): \d+\.firefly < b"
-    testbed_regex_dc = re.compile(r"{}'Energest: (?P<cnt>\d+) (?P<cpu>\d+) "
-                                  r"(?P<lpm>\d+) (?P<tx>\d+) (?P<rx>\d+)'".format(testbed_record_pattern))
+                    e.epoch_counts[(node_id, epoch)] = (n_count_discovered, n_count_discovered_new)
+
+                    e.max_epoch = max(e.max_epoch, epoch)
+
+            # Energ test
+
+            elif "Energest:" in line:
+                m = regex["dc"].match(line)
+                if m:
+                    nid = node(m.group('self_id'))
+                    cnt, cpu, lpm, tx, rx = (int(v) for v in m.group('cnt', 'cpu', 'lpm', 'tx', 'rx'))
+
+                    v = e.data_energest.get(nid)
+                    if v is None:
+                        v = e.data_energest[nid] = {'self_id': nid, 'cpu': cpu, 'lpm': lpm, 'tx': tx, 'rx': rx}
+
+                    if cnt >= 2:
+                        v['cpu'] += cpu
+                        v['lpm'] += lpm
+                        v['tx'] += tx
+                        v['rx'] += rx
+
+            elif " radio idle " in line:
+                m = regex["phase"].match(line)
+                if m:
+                    nid = node(m.group('self_id'))
+                    ticks = [int(v) for v in m.groups()[-2 * len(PHASES):]]
+                    if nid in e.data_phase:
+                        e.data_phase[nid] = [a + b for a, b in zip(e.data_phase[nid], ticks)]
+                        e.phase_epochs[nid] += 1
+                    else:
+                        e.data_phase[nid] = ticks
+                        e.phase_epochs[nid] = 1
+
+            elif " heard " in line:
+                m = regex["heard"].match(line)
+                if m:
+                    pair = (node(m.group('self_id')), int(m.group('nbr')))
+                    heard = int(m.group('low')) | int(m.group('high')) << 16
+                    if pair not in e.heard or heard < e.heard[pair]:
+                        e.heard[pair] = heard
+
+            elif " busy " in line:
+                m = regex["tx"].match(line)
+                if m:
+                    key = (node(m.group('self_id')), int(m.group('epoch')))
+                    e.tx_counts[key] = tuple(int(v) for v in m.groups()[-len(ACCESS):])
+
+            elif " hop tx " in line:
+                m = regex["hop"].match(line)
+                if m:
+                    key = (node(m.group('self_id')), int(m.group('epoch')))
+                    e.hop_channels[key] = (int(m.group('tx')), int(m.group('rx')))
+
+    e.collect_channels()
+    e.clear_empty_nodes()
+    return e
 
-    pattern_settings = cooja_patter_settings
-    pattern_new_n = cooja_pattern_new_n
-    pattern_epoch_end = cooja_pattern_epoch_end
-    regex_dc = cooja_regex_dc
 
-    c = 0
-    for line in f:
-        if c == 0:
-            m = re.search(pattern_check_testbed, line)
-            if m:
-                e.is_testbed = True
-                e.testbed_job_id = int(m.group(1))
-                pattern_settings = testbed_pattern_settings
-                pattern_new_n = testbed_pattern_new_n
-                pattern_epoch_end = testbed_pattern_epoch_end
-                regex_dc = testbed_regex_dc
-
-        if not settings_found:
-            m = re.search(pattern_settings, line)
-
-            if m:
-                e.TYPE = m.group(2)
-                e.TRANSMISSION_WINDOW_COUNT = m.group(3)
-                e.RECEPTION_WINDOW_COUNT = m.group(4)
-                e.TRANSMISSION_WINDOW_DURATION = m.group(5)
-                e.RECEPTION_WINDOW_DURATION = m.group(6)
-                e.TRANSMISSION_PER_WINDOW = m.group(7)
-                e.TRANSMISSION_DURATION = m.group(8)
-                e.RECEPTION_DURATION = m.group(9)
-                settings_found = True
-
-        match = re.search(pattern_new_n, line)
-        epoch = 0
-
-        if epoch <= 199:
-            if match:
-                node_id = int(match.group(1))
-                epoch = int(match.group(2))
-                n_discovered = int(match.group(3))
-
-                if node_id > e.max_node_id:
-                    e.max_node_id = node_id
-
-                print(node_id)
-                n = e.nodes[int(node_id)]
-                n.node_id = node_id
-                if (not n_discovered in n.neighbours):
-                    n.neighbours.append(n_discovered)
-
-            else:
-                finish_match = re.search(pattern_epoch_end, line)
-                if finish_match:
-                    node_id = int(finish_match.group(1))
-                    epoch = int(finish_match.group(2))
+# Settings read from the START line, cached as they are
+SETTINGS = ["TYPE", "TRANSMISSION_WINDOW_COUNT", "RECEPTION_WINDOW_COUNT", "TRANSMISSION_WINDOW_DURATION",
+            "RECEPTION_WINDOW_DURATION", "TRANSMISSION_PER_WINDOW", "TRANSMISSION_DURATION", "RECEPTION_DURATION"]
+
+
+def cache_path(filename) -> str:
+    """Cache file of a log, keyed by its content, the parser version and the
+    deployment table"""
+    h = hashlib.sha1()
+    h.update(f"{PARSER_VERSION} {Experiment.TRUNC_EP_LOW} {Experiment.TRUNC_EP_HIGH} {DEPLOYMENT.digest}\n".encode())
+    with open(filename, "rb") as f:
+        for chunk in iter(lambda: f.read(1 << 20), b""):
+            h.update(chunk)
+    return join(dirname(filename), CACHE_FOLDER, f"{basename(filename)}.{h.hexdigest()[:16]}.npz")
+
+
+def save_cache(e: Experiment, path):
+    """Stores what parse_lines() read as columns: the per-node arrays, the
+    neighbour lists flattened with their offsets, the energest and phase
+    sums one row per node id in the order they were read, the start times,
+    the first heard ticks and the channel figures"""
+    meta = {k: getattr(e, k) for k in SETTINGS if k in vars(e)}
+    meta.update(max_node_id=e.max_node_id, max_epoch=e.max_epoch, is_testbed=e.is_testbed,
+                testbed_job_id=e.testbed_job_id, epochs=e.epochs)
+    energest = e.data_energest.items()
+    phase = e.data_phase.items()
+    start = e.start_time.items()
+    heard = e.heard.items()
+
+    os.makedirs(dirname(path), exist_ok=True)
+    tmp = path + ".tmp"
+    with open(tmp, "wb") as f:
+        np.savez(f,
+                 meta=np.array(json.dumps(meta)),
+                 node_id=e.node_ids,
+                 n_count=e.n_count_epoch,
+                 n_new=e.n_new_count_epoch,
+                 nbr_offset=np.cumsum([0] + [len(n) for n in e.neighbours], dtype=np.int64),
+                 nbr_id=np.array([i for n in e.neighbours for i in n], dtype=np.int64),
+                 energest=np.array([[nid, v['cpu'], v['lpm'], v['tx'], v['rx']] for nid, v in energest],
+                                   dtype=np.int64).reshape(-1, 5),
+                 phase=np.array([[nid, e.phase_epochs[nid]] + v for nid, v in phase],
+                                dtype=np.int64).reshape(-1, 2 + 2 * len(PHASES)),
+                 start_id=np.array([nid for nid, t in start], dtype=np.int64),
+                 start_time=np.array([t for nid, t in start], dtype=np.float64),
+                 heard=np.array([[nid, nbr, t] for (nid, nbr), t in heard], dtype=np.int64).reshape(-1, 3),
+                 access=e.access,
+                 channels=e.channels)
+    os.replace(tmp, path)
+
+
+def load_cache(path) -> Experiment:
+    """Rebuilds the Experiment stored by save_cache()"""
+    e = Experiment()
+    with np.load(path, allow_pickle=False) as z:
+        for k, v in json.loads(str(z["meta"])).items():
+            setattr(e, k, v)
+
+        e.node_ids = z["node_id"]
+        e.node_index = {nid: row for row, nid in enumerate(e.node_ids.tolist())}
+        e.n_count_epoch = z["n_count"]
+        e.n_new_count_epoch = z["n_new"]
+        offsets = z["nbr_offset"].tolist()
+        nbr_ids = z["nbr_id"].tolist()
+        e.neighbours = [nbr_ids[offsets[i]:offsets[i + 1]] for i in range(len(e.node_ids))]
+        e.neighbour_count = np.diff(z["nbr_offset"])
+        e.duty_cycle = np.zeros(len(e.node_ids))
+
+        for nid, cpu, lpm, tx, rx in z["energest"].tolist():
+            e.data_energest[nid] = {'self_id': nid, 'cpu': cpu, 'lpm': lpm, 'tx': tx, 'rx': rx}
+        for row in z["phase"].tolist():
+            e.data_phase[row[0]] = row[2:]
+            e.phase_epochs[row[0]] = row[1]
+        e.start_time = dict(zip(z["start_id"].tolist(), z["start_time"].tolist()))
+        e.heard = {(nid, nbr): t for nid, nbr, t in z["heard"].tolist()}
+        e.access = z["access"]
+        e.channels = z["channels"]
 
-                    if epoch > 199:
-                        continue
+    return e
 
-                    n_count_discovered = int(finish_match.group(3))
-                    n_count_discovered_new = int(finish_match.group(4))  # new discovered
 
-                    n = e.nodes[node_id]
-                    n.neighbour_count += n_count_discovered_new
-                    n.n_count_epoch[epoch] = n_count_discovered
-                    n.n_new_count_epoch[epoch] = n_count_discovered_new
-                    # print(f"id: {node_id}, epoch: {epoch}, n_discovered: {n_count_discovered}")
-
-        # Energ test
-
-        m = regex_dc.match(line)
-        if m:
-            d = m.groupdict()
-            if e.is_testbed:
-                ts = datetime.strptime(d["time"], '%Y-%m-%d %H:%M:%S,%f')
-                ts = ts.timestamp()
-            else:
-                ts = d["time"]
-
-            d['self_id'] = int(d['self_id'])
-            d['cpu'] = int(d['cpu'])
-            d['lpm'] = int(d['lpm'])
-            d['tx'] = int(d['tx'])
-            d['rx'] = int(d['rx'])
-
-            if e.data_energest.get(d['self_id']) is None:
-                e.data_energest[d['self_id']] = {
-                    'self_id': d['self_id'],
-                    'cpu': d['cpu'],
-                    'lpm': d['lpm'],
-                    'tx': d['tx'],
-                    'rx': d['rx'],
-                }
-
-            if int(d['cnt']) >= 2:
-                e.data_energest[d['self_id']]['cpu'] += d['cpu']
-                e.data_energest[d['self_id']]['lpm'] += d['lpm']
-                e.data_energest[d['self_id']]['tx'] += d['tx']
-                e.data_energest[d['self_id']]['rx'] += d['rx']
-
-        c += 1
-
-        e.max_epoch = max(e.max_epoch, epoch)
+def parse(filename=FILENAME, log_file=False, printinfo=False, use_cache=True) -> Experiment:
+    e = None
+    if use_cache:
+        path = cache_path(filename)
+        if os.path.exists(path):
+            e = load_cache(path)
+    if e is None:
+        e = parse_lines(filename)
+        if use_cache:
+            save_cache(e, path)
 
-    e.clear_empty_nodes()
     e.calculate_energest()
+    e.calculate_phase_energy()
+    e.calculate_channels()
     e.calculate_values()
-
-    f.close()
+    e.calculate_latency()
 
     if printinfo:
         print_output(e)
@@ -310,29 +631,37 @@ def parse(filename=FILENAME, log_file=False, printinfo=False) -> Experiment:
     return e
 
 
+def parse_all(filepaths: list[str]) -> list[Experiment]:
+    """Parses the files in parallel, at most one process per core, in the
+    order given"""
+    if len(filepaths) < 2:
+        return [parse(fp) for fp in filepaths]
+    with ProcessPoolExecutor(max_workers=min(len(filepaths), os.cpu_count() or 1)) as pool:
+        return list(pool.map(parse, filepaths))
+
+
 def print_output(e: Experiment):
-    n_perc_sum = 0
+    others = len(e.node_ids) - 1
+    discover_perc = np.round(e.neighbour_count / others, 2)
 
-    for i in e.nodes:
+    for row, node_id in enumerate(e.node_ids):
         print(f"max n id {e.max_node_id}")
-        discover_perc = round(i.neighbour_count / (e.max_node_id - 1), 2)
-        n_perc_sum += discover_perc
         print(
-            f"node id: {i.node_id},\tneigh_count: {i.neighbour_count}/{e.max_node_id - 1},\tdiscover_perc: {discover_perc},\tneighbours: {i.neighbours}")
-        print(f"neigh: {i.n_count_epoch}")
-        print(f"neigh new: {i.n_new_count_epoch}")
-    print(f"avg_discover_perc: {n_perc_sum / (e.max_node_id)}")
+            f"node id: {node_id},\tneigh_count: {e.neighbour_count[row]}/{others},\tdiscover_perc: {discover_perc[row]},\tneighbours: {e.neighbours[row]}")
+        print(f"neigh: {e.n_count_epoch[row].tolist()}")
+        print(f"neigh new: {e.n_new_count_epoch[row].tolist()}")
+    print(f"avg_discover_perc: {discover_perc.sum() / len(e.node_ids)}")
 
 
 def plot_n_discovered_per_epoch(e: Experiment):
     fig, axs = plt.subplots(1, 1)
 
-    for n in e.nodes:
-        axs.plot(e.epochs, n.n_count_epoch, label=n.node_id)
-        # axs[0].set_xlim(0, 2)
-        axs.set_xlabel('Epoch')
-        axs.set_ylabel('s1 and s2')
-        # axs.grid(True)
+    for node_id, row in zip(e.node_ids, e.n_count_epoch):
+        axs.plot(e.epochs, row, label=node_id)
+    # axs[0].set_xlim(0, 2)
+    axs.set_xlabel('Epoch')
+    axs.set_ylabel('s1 and s2')
+    # axs.grid(True)
 
     # plt.legend()
     plt.show()
@@ -354,10 +683,10 @@ def plot_n_discovered_per_epoch_avg(e: Experiment):
 def plot_n_new_discovered_per_epoch(e: Experiment):
     fig, axs = plt.subplots(1, 1)
 
-    for n in e.nodes:
-        axs.plot(e.epochs, n.n_new_count_epoch, label=n.node_id)
-        axs.set_xlabel('Epoch')
-        axs.set_ylabel('s1 and s2')
+    for node_id, row in zip(e.node_ids, e.n_new_count_epoch):
+        axs.plot(e.epochs, row, label=node_id)
+    axs.set_xlabel('Epoch')
+    axs.set_ylabel('s1 and s2')
 
     # plt.legend()
     plt.show()
@@ -407,6 +736,22 @@ def plot_exps_n_new_discovered_per_epoch(exps: list[Experiment]):
     plt.show()
 
 
+def plot_exps_latency_cdf(exps: list[Experiment]):
+    fig, ax = plt.subplots()
+
+    for e in exps:
+        if len(e.latency) == 0:
+            continue
+        x, y = e.latency_cdf()
+        ax.step(x, y, where="post", label=e.name)
+
+    ax.set_xlabel('discovery latency (s)')
+    ax.set_ylabel('fraction of node pairs')
+
+    plt.legend()
+    plt.show()
+
+
 # TODO: usare
 def plot_exps_dc_avg_n_discovered(exps: list[Experiment]):
     fig, ax = plt.subplots()
@@ -427,10 +772,7 @@ def run_exps():
     for fn in FILENAMES:
         FILEPATHS.append(join(LOGS_FOLDER, fn))
 
-    expmnts = []
-
-    for fp in FILEPATHS:
-        expmnts.append(parse(fp))
+    expmnts = parse_all(FILEPATHS)
 
     print("Experiments considered:")
     for ep in expmnts:
@@ -440,6 +782,7 @@ def run_exps():
     # plot_exps_n_new_discovered_per_epoch(expmnts)
     # plot_exps_dc_avg_n_discovered(expmnts)
     plot_exps_n_discovered_per_epoch(expmnts)
+    # plot_exps_latency_cdf(expmnts)
 
     # for ep in expmnts:
     #   plot_n_discovered_per_epoch_avg(ep)
@@ -455,5 +798,6 @@ def run_exps():
     """
 
 
-run_exps()  # Generate graphs
-# parse(log_file=True, printinfo=True) # First file parse
+if __name__ == "__main__":
+    run_exps()  # Generate graphs
+    # parse(log_file=True, printinfo=True) # First file parse
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Regression runs of nd-sim, see "make check". Each configuration must have
+# the same tick constants with the 16 bit int of sky as on the host (see
+# ticks16.py), is built with its ND_DEFINES and must run to the end of the
+# simulated time, end epochs on every node and never drop a schedule entry.
+cd "$(dirname "$0")" || exit 1
+
+failed=0
+
+# name, then the ND_DEFINES of the build
+check()
+{
+  name=$1
+  shift
+  dir=build/check/$name
+  log=$dir/test.log
+  # the host int is 32 bits, the constants are checked at the 16 bits of sky
+  if ! ./ticks16.py ND_CONF_LOG_TEXT=1 "$@"; then
+    echo "FAIL $name: tick constants wrap with a 16 bit int"
+    failed=1
+    return
+  fi
+  if ! make -s BUILD="$dir" SIM="$dir/nd-sim" ND_DEFINES="ND_CONF_LOG_TEXT=1 $*"; then
+    echo "FAIL $name: build"
+    failed=1
+    return
+  fi
+  timeout 60 "$dir/nd-sim" -n 10 -d 5 -t 20 -o "$log" 2>/dev/null
+  rc=$?
+  if [ $rc -ne 0 ]; then
+    echo "FAIL $name: nd-sim exited with $rc"
+    failed=1
+  elif grep -q "schedule full\|ND not started" "$log"; then
+    echo "FAIL $name: $(grep -m1 "schedule full\|ND not started" "$log" | cut -f2-)"
+    failed=1
+  elif [ "$(grep "finished Num NBR" "$log" | cut -f2 | sort -u | wc -l)" -ne 10 ]; then
+    echo "FAIL $name: not every node ended its epochs"
+    failed=1
+  else
+    echo "ok   $name"
+  fi
+}
+
+check burst APP_CONF_ND_MODE=ND_BURST
+check scatter APP_CONF_ND_MODE=ND_SCATTER
+# budgets low enough to need the longest schedules
+check budget-scatter-20000 APP_CONF_ND_MODE=ND_SCATTER APP_CONF_ND_BUDGET_PPM=20000
+check budget-scatter-30000 APP_CONF_ND_MODE=ND_SCATTER APP_CONF_ND_BUDGET_PPM=30000
+check budget-scatter-adaptive-20000 APP_CONF_ND_MODE=ND_SCATTER+ND_ADAPTIVE APP_CONF_ND_BUDGET_PPM=20000
+check budget-burst-20000 APP_CONF_ND_MODE=ND_BURST APP_CONF_ND_BUDGET_PPM=20000
+
+exit $failed
@@ -0,0 +1,27 @@
+/*---------------------------------------------------------------------------*/
+/* Host platform configuration used by the ND simulator (see sim/sim.h).
+ * Mirrors the sky target: 16-bit rtimer at 32768 Hz, 128 Hz clock.
+ * RTIMER_CONF_SECOND is an unsigned int as there, though of 32 bits on the
+ * host; check.sh evaluates the tick constants at 16 bits (ticks16.py).
+ */
+#ifndef CONTIKI_CONF_H_
+#define CONTIKI_CONF_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef PROJECT_CONF_H
+#include PROJECT_CONF_H
+#endif /* PROJECT_CONF_H */
+
+#define CONTIKI_TARGET_SIM 1
+
+#define CLOCK_CONF_SECOND 128
+#define RTIMER_CONF_SECOND (4096U*8)
+
+typedef unsigned long clock_time_t;
+typedef unsigned short rtimer_clock_t;
+
+#endif /* CONTIKI_CONF_H_ */
+/*---------------------------------------------------------------------------*/
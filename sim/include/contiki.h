@@ -0,0 +1,13 @@
+/*---------------------------------------------------------------------------*/
+#ifndef CONTIKI_H_
+#define CONTIKI_H_
+
+#include "contiki-conf.h"
+
+#include "sys/process.h"
+#include "sys/clock.h"
+#include "sys/etimer.h"
+#include "sys/rtimer.h"
+
+#endif /* CONTIKI_H_ */
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,11 @@
+/*---------------------------------------------------------------------------*/
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#define RANDOM_RAND_MAX 65535U
+
+void random_init(unsigned short seed);
+unsigned short random_rand(void);
+
+#endif /* RANDOM_H_ */
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,28 @@
+/*---------------------------------------------------------------------------*/
+#ifndef RDC_H_
+#define RDC_H_
+
+#include "net/mac/mac.h"
+#include "net/queuebuf.h"
+
+/* List of packets to be sent by the RDC layer */
+struct rdc_buf_list {
+  struct rdc_buf_list *next;
+  struct queuebuf *buf;
+  void *ptr;
+};
+
+struct rdc_driver {
+  char *name;
+  void (* init)(void);
+  void (* send)(mac_callback_t sent_callback, void *ptr);
+  void (* send_list)(mac_callback_t sent_callback, void *ptr,
+                     struct rdc_buf_list *list);
+  void (* input)(void);
+  int (* on)(void);
+  int (* off)(int keep_radio_on);
+  unsigned short (* channel_check_interval)(void);
+};
+
+#endif /* RDC_H_ */
+/*---------------------------------------------------------------------------*/
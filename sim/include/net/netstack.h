@@ -0,0 +1,25 @@
+/*---------------------------------------------------------------------------*/
+/* The simulator always runs the project stack: nd_rdc_driver on top of the
+ * simulated medium.
+ */
+#ifndef NETSTACK_H_
+#define NETSTACK_H_
+
+#include "contiki-conf.h"
+#include "dev/radio.h"
+#include "net/mac/rdc.h"
+
+struct network_driver {
+  char *name;
+  void (* init)(void);
+  void (* input)(void);
+};
+
+#define NETSTACK_RADIO sim_radio_driver
+#define NETSTACK_RDC nd_rdc_driver
+
+extern const struct radio_driver sim_radio_driver;
+extern const struct rdc_driver nd_rdc_driver;
+
+#endif /* NETSTACK_H_ */
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,29 @@
+/*---------------------------------------------------------------------------*/
+#ifndef PACKETBUF_H_
+#define PACKETBUF_H_
+
+#include "contiki-conf.h"
+
+#define PACKETBUF_SIZE 128
+
+typedef uint16_t packetbuf_attr_t;
+
+enum {
+  PACKETBUF_ATTR_NONE,
+  PACKETBUF_ATTR_CHANNEL,
+  PACKETBUF_ATTR_RSSI,
+  PACKETBUF_ATTR_LINK_QUALITY,
+  PACKETBUF_ATTR_TIMESTAMP,
+  PACKETBUF_NUM_ATTRS
+};
+
+void packetbuf_clear(void);
+void *packetbuf_dataptr(void);
+uint16_t packetbuf_datalen(void);
+void packetbuf_set_datalen(uint16_t len);
+int packetbuf_copyfrom(const void *from, uint16_t len);
+packetbuf_attr_t packetbuf_attr(uint8_t type);
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val);
+
+#endif /* PACKETBUF_H_ */
+/*---------------------------------------------------------------------------*/
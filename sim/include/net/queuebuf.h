@@ -0,0 +1,15 @@
+/*---------------------------------------------------------------------------*/
+#ifndef QUEUEBUF_H_
+#define QUEUEBUF_H_
+
+#include "net/packetbuf.h"
+
+struct queuebuf {
+  uint16_t len;
+  uint8_t data[PACKETBUF_SIZE];
+};
+
+void queuebuf_to_packetbuf(struct queuebuf *b);
+
+#endif /* QUEUEBUF_H_ */
+/*---------------------------------------------------------------------------*/
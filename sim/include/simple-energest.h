@@ -0,0 +1,9 @@
+/*---------------------------------------------------------------------------*/
+#ifndef SIMPLE_ENERGEST_H_
+#define SIMPLE_ENERGEST_H_
+
+/* Prints "Energest: cnt cpu lpm tx rx" deltas every 15 s, in rtimer ticks */
+void simple_energest_start(void);
+
+#endif /* SIMPLE_ENERGEST_H_ */
+/*---------------------------------------------------------------------------*/
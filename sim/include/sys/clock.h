@@ -0,0 +1,13 @@
+/*---------------------------------------------------------------------------*/
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include "contiki-conf.h"
+
+#define CLOCK_SECOND CLOCK_CONF_SECOND
+
+clock_time_t clock_time(void);
+unsigned long clock_seconds(void);
+
+#endif /* CLOCK_H_ */
+/*---------------------------------------------------------------------------*/
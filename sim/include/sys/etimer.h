@@ -0,0 +1,28 @@
+/*---------------------------------------------------------------------------*/
+#ifndef ETIMER_H_
+#define ETIMER_H_
+
+#include "sys/clock.h"
+#include "sys/process.h"
+
+struct timer {
+  clock_time_t start;
+  clock_time_t interval;
+};
+
+struct etimer {
+  struct timer timer;
+  struct etimer *next;
+  struct process *p;
+  unsigned int sim_gen; /* matches the pending simulator event */
+};
+
+void etimer_set(struct etimer *et, clock_time_t interval);
+void etimer_reset(struct etimer *et);
+void etimer_restart(struct etimer *et);
+void etimer_stop(struct etimer *et);
+int etimer_expired(struct etimer *et);
+clock_time_t etimer_expiration_time(struct etimer *et);
+
+#endif /* ETIMER_H_ */
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,9 @@
+/*---------------------------------------------------------------------------*/
+#ifndef NODE_ID_H_
+#define NODE_ID_H_
+
+/* Defined in sim/node-id.c so that every simulated node has its own copy */
+extern unsigned short node_id;
+
+#endif /* NODE_ID_H_ */
+/*---------------------------------------------------------------------------*/
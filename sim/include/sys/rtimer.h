@@ -0,0 +1,38 @@
+/*---------------------------------------------------------------------------*/
+/* Single-slot rtimer, like the MSP430 and CC2538 ports: a new rtimer_set()
+ * replaces the pending one and a time in the past fires after the 16-bit
+ * counter wraps.
+ */
+#ifndef RTIMER_H_
+#define RTIMER_H_
+
+#include "contiki-conf.h"
+
+#define RTIMER_SECOND RTIMER_CONF_SECOND
+
+#define RTIMER_NOW() rtimer_arch_now()
+#define RTIMER_CLOCK_DIFF(a, b) ((signed short)((a) - (b)))
+#define RTIMER_CLOCK_LT(a, b) (RTIMER_CLOCK_DIFF(a, b) < 0)
+
+struct rtimer;
+typedef void (* rtimer_callback_t)(struct rtimer *t, void *ptr);
+
+struct rtimer {
+  rtimer_clock_t time;
+  rtimer_callback_t func;
+  void *ptr;
+};
+
+enum {
+  RTIMER_OK,
+  RTIMER_ERR_FULL,
+  RTIMER_ERR_TIME,
+  RTIMER_ERR_ALREADY_SCHEDULED,
+};
+
+int rtimer_set(struct rtimer *task, rtimer_clock_t time,
+               rtimer_clock_t duration, rtimer_callback_t func, void *ptr);
+rtimer_clock_t rtimer_arch_now(void);
+
+#endif /* RTIMER_H_ */
+/*---------------------------------------------------------------------------*/
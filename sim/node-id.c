@@ -0,0 +1,4 @@
+/*---------------------------------------------------------------------------*/
+/* Linked into the per-node image: each simulated node has its own node_id */
+unsigned short node_id = 0;
+/*---------------------------------------------------------------------------*/
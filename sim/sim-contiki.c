@@ -0,0 +1,323 @@
+/*---------------------------------------------------------------------------*/
+/* Contiki stubs: processes, etimer, rtimer, clock, random, packetbuf, queuebuf,
+ * the MAC sent callback, simple-energest and the serial output of the
+ * simulated nodes.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "lib/random.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/mac/mac.h"
+#include "node-id.h"
+/*---------------------------------------------------------------------------*/
+#define ENERGEST_PERIOD (15 * SIM_SECOND)
+
+extern struct process *const autostart_processes[];
+
+struct process *process_current = PROCESS_NONE;
+/*---------------------------------------------------------------------------*/
+void sim_boot(void)
+{
+  struct sim_node *n = sim_node();
+
+  node_id = n->id;
+  NETSTACK_RADIO.init();
+  NETSTACK_RDC.init();
+
+  for (int i = 0; autostart_processes[i] != NULL; i++)
+  {
+    process_start(autostart_processes[i], NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void sim_process_dispatch(struct process *p, process_event_t ev,
+                          process_data_t data)
+{
+  if (!p->state)
+  {
+    return;
+  }
+  if (ev == PROCESS_EVENT_POLL)
+  {
+    p->needspoll = 0;
+  }
+
+  struct process *caller = process_current;
+  process_current = p;
+  int ret = p->thread(&p->pt, ev, data);
+  if (ret == PT_EXITED || ret == PT_ENDED)
+  {
+    p->state = 0;
+  }
+  process_current = caller;
+}
+
+void process_start(struct process *p, process_data_t data)
+{
+  if (p->state)
+  {
+    return;
+  }
+  p->state = 1;
+  p->needspoll = 0;
+  PT_INIT(&p->pt);
+  sim_process_dispatch(p, PROCESS_EVENT_INIT, data);
+}
+
+int process_post(struct process *p, process_event_t ev, process_data_t data)
+{
+  if (p != PROCESS_NONE)
+  {
+    sim_schedule(sim_now, SIM_EV_PROCESS, sim_current, ev, p, data);
+  }
+  return PROCESS_ERR_OK;
+}
+
+void process_post_synch(struct process *p, process_event_t ev, process_data_t data)
+{
+  sim_process_dispatch(p, ev, data);
+}
+
+void process_poll(struct process *p)
+{
+  if (p != PROCESS_NONE && !p->needspoll)
+  {
+    p->needspoll = 1;
+    process_post(p, PROCESS_EVENT_POLL, NULL);
+  }
+}
+
+process_event_t process_alloc_event(void)
+{
+  return sim_node()->last_event++;
+}
+/*---------------------------------------------------------------------------*/
+clock_time_t clock_time(void)
+{
+  return (clock_time_t)(sim_now * CLOCK_SECOND / SIM_SECOND);
+}
+
+unsigned long clock_seconds(void)
+{
+  return (unsigned long)(sim_now / SIM_SECOND);
+}
+/*---------------------------------------------------------------------------*/
+static void
+etimer_arm(struct etimer *et)
+{
+  clock_time_t expiry = et->timer.start + et->timer.interval;
+  sim_time_t at = ((sim_time_t)expiry * SIM_SECOND + CLOCK_SECOND - 1) / CLOCK_SECOND;
+
+  et->p = PROCESS_CURRENT();
+  et->sim_gen++;
+  sim_schedule(at > sim_now ? at : sim_now, SIM_EV_ETIMER, sim_current, et->sim_gen, et, NULL);
+}
+
+void etimer_set(struct etimer *et, clock_time_t interval)
+{
+  et->timer.start = clock_time();
+  et->timer.interval = interval;
+  etimer_arm(et);
+}
+
+void etimer_reset(struct etimer *et)
+{
+  et->timer.start += et->timer.interval;
+  etimer_arm(et);
+}
+
+void etimer_restart(struct etimer *et)
+{
+  et->timer.start = clock_time();
+  etimer_arm(et);
+}
+
+void etimer_stop(struct etimer *et)
+{
+  et->p = PROCESS_NONE;
+  et->sim_gen++;
+}
+
+int etimer_expired(struct etimer *et)
+{
+  return et->p == PROCESS_NONE;
+}
+
+clock_time_t etimer_expiration_time(struct etimer *et)
+{
+  return et->timer.start + et->timer.interval;
+}
+
+void sim_etimer_fire(struct etimer *et, uint32_t gen)
+{
+  struct process *p = et->p;
+
+  if (et->sim_gen != gen || p == PROCESS_NONE)
+  {
+    return;
+  }
+  et->p = PROCESS_NONE;
+  sim_process_dispatch(p, PROCESS_EVENT_TIMER, et);
+}
+/*---------------------------------------------------------------------------*/
+rtimer_clock_t rtimer_arch_now(void)
+{
+  return (rtimer_clock_t)sim_ticks(sim_now);
+}
+
+int rtimer_set(struct rtimer *task, rtimer_clock_t time,
+               rtimer_clock_t duration, rtimer_callback_t func, void *ptr)
+{
+  struct sim_node *n = sim_node();
+  uint64_t now = sim_ticks(sim_now);
+  /* a time in the past is only reached after the counter wraps */
+  rtimer_clock_t delta = (rtimer_clock_t)(time - (rtimer_clock_t)now);
+
+  task->time = time;
+  task->func = func;
+  task->ptr = ptr;
+  n->rt = task;
+  n->rt_gen++;
+  sim_schedule(sim_ticks_to_time(now + delta), SIM_EV_RTIMER, sim_current, n->rt_gen, task, NULL);
+  return RTIMER_OK;
+}
+
+void sim_rtimer_fire(struct rtimer *t)
+{
+  t->func(t, t->ptr);
+}
+/*---------------------------------------------------------------------------*/
+void random_init(unsigned short seed)
+{
+  (void)seed; /* all nodes draw from the simulator's seeded generator */
+}
+
+unsigned short random_rand(void)
+{
+  return (unsigned short)sim_rand();
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t packetbuf[PACKETBUF_SIZE];
+static uint16_t packetbuf_len;
+static packetbuf_attr_t packetbuf_attrs[PACKETBUF_NUM_ATTRS];
+
+void packetbuf_clear(void)
+{
+  packetbuf_len = 0;
+  memset(packetbuf_attrs, 0, sizeof(packetbuf_attrs));
+}
+
+void *packetbuf_dataptr(void)
+{
+  return packetbuf;
+}
+
+uint16_t packetbuf_datalen(void)
+{
+  return packetbuf_len;
+}
+
+void packetbuf_set_datalen(uint16_t len)
+{
+  packetbuf_len = len;
+}
+
+int packetbuf_copyfrom(const void *from, uint16_t len)
+{
+  packetbuf_len = len < PACKETBUF_SIZE ? len : PACKETBUF_SIZE;
+  memcpy(packetbuf, from, packetbuf_len);
+  return packetbuf_len;
+}
+
+packetbuf_attr_t packetbuf_attr(uint8_t type)
+{
+  return type < PACKETBUF_NUM_ATTRS ? packetbuf_attrs[type] : 0;
+}
+
+int packetbuf_set_attr(uint8_t type, const packetbuf_attr_t val)
+{
+  if (type < PACKETBUF_NUM_ATTRS)
+  {
+    packetbuf_attrs[type] = val;
+  }
+  return 1;
+}
+
+void queuebuf_to_packetbuf(struct queuebuf *b)
+{
+  packetbuf_clear();
+  packetbuf_copyfrom(b->data, b->len);
+}
+
+void mac_call_sent_callback(mac_callback_t sent, void *ptr, int status, int num_tx)
+{
+  if (sent != NULL)
+  {
+    sent(ptr, status, num_tx);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void simple_energest_start(void)
+{
+  sim_schedule(sim_now + ENERGEST_PERIOD, SIM_EV_ENERGEST, sim_current, 0, NULL, NULL);
+}
+
+/**
+ * Radio figures come from the medium; the CPU is not modelled, so the whole
+ * period is reported as LPM.
+ */
+void sim_energest_report(void)
+{
+  struct sim_node *n = sim_node();
+  uint64_t tx, rx;
+
+  sim_radio_account(n);
+  tx = sim_ticks(n->tx_time);
+  rx = sim_ticks(n->rx_time);
+  sim_printf("Energest: %lu %lu %lu %lu %lu\n",
+             n->energest_cnt++, 0UL, (unsigned long)sim_ticks(ENERGEST_PERIOD),
+             (unsigned long)(tx - n->energest_tx), (unsigned long)(rx - n->energest_rx));
+  n->energest_tx = tx;
+  n->energest_rx = rx;
+  simple_energest_start();
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Serial output in the Cooja log format: "<time us>\tID:<id>\t<line>"
+ */
+int sim_printf(const char *fmt, ...)
+{
+  struct sim_node *n = sim_node();
+  char buf[256];
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  if (len > (int)sizeof(buf) - 1)
+  {
+    len = sizeof(buf) - 1;
+  }
+
+  for (int i = 0; i < len; i++)
+  {
+    if (buf[i] == '\n' || n->line_len == sizeof(n->line) - 1)
+    {
+      fprintf(sim_out, "%llu\tID:%u\t%.*s\n", (unsigned long long)sim_now, n->id, n->line_len, n->line);
+      n->line_len = 0;
+      if (buf[i] == '\n')
+      {
+        continue;
+      }
+    }
+    n->line[n->line_len++] = buf[i];
+  }
+  return len;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,467 @@
+/*---------------------------------------------------------------------------*/
+/* Simulated radio: NETSTACK_RADIO driver, shared medium and radio models.
+ *
+ * A frame is received if the receiver was listening on the same channel when
+ * it started, did not transmit or turn the radio off before it ended and,
+ * when collisions are modelled, sensed no other signal in the meantime.
+ * Each delivery is then subject to the link's reception ratio.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+/*---------------------------------------------------------------------------*/
+#define BYTE_TIME_US 32    /* 250 kbps */
+#define PHY_OVERHEAD 8     /* preamble, SFD, length and FCS bytes */
+#define SHR_LEN 5          /* preamble and SFD bytes */
+#define CHANNEL_MIN 11
+#define CHANNEL_MAX 26
+/*---------------------------------------------------------------------------*/
+/* frames a listening neighbour would have received but for another signal */
+unsigned long long sim_rx_collisions;
+/*---------------------------------------------------------------------------*/
+/* Log-distance path loss, 0 dBm at the sender */
+static void
+link_quality(double dist, struct sim_link *l)
+{
+  double rssi = -45.0 - 25.0 * log10(dist > 1.0 ? dist : 1.0);
+
+  if (rssi < -100.0)
+  {
+    rssi = -100.0;
+  }
+  l->rssi = (int8_t)lround(rssi);
+  l->lqi = (uint8_t)(50 + (l->rssi + 100) * 60 / 55);
+}
+
+static int
+udg_link(double dist, struct sim_link *l)
+{
+  if (dist > sim_config.range)
+  {
+    return 0;
+  }
+  l->prr = (float)(1.0 - sim_config.loss);
+  link_quality(dist, l);
+  return 1;
+}
+
+static int
+udgm_link(double dist, struct sim_link *l)
+{
+  double ratio = (dist * dist) / (sim_config.range * sim_config.range);
+
+  if (ratio > 4.0)
+  {
+    return 0;
+  }
+  l->prr = ratio > 1.0 ? 0.0f : (float)(1.0 - ratio * sim_config.loss);
+  link_quality(dist, l);
+  return 1;
+}
+
+static const struct sim_radio_model udg_model = {
+    "udg",
+    "unit disk, every frame in range is lost with probability -l",
+    1.0,
+    udg_link};
+
+static const struct sim_radio_model udgm_model = {
+    "udgm",
+    "Cooja-like UDGM: loss grows to -l at the range edge, interference up to twice the range",
+    2.0,
+    udgm_link};
+
+const struct sim_radio_model *const sim_radio_models[] = {
+    &udg_model,
+    &udgm_model,
+    NULL};
+/*---------------------------------------------------------------------------*/
+/**
+ * Compute the links of every node, bucketing nodes in a grid whose cells are
+ * as large as the sensing range.
+ */
+void sim_radio_build_links(void)
+{
+  double sense = sim_config.range * sim_config.model->sense_factor;
+  double min_x = sim_nodes[0].x, min_y = sim_nodes[0].y;
+  double max_x = min_x, max_y = min_y;
+
+  for (uint32_t i = 1; i < sim_n_nodes; i++)
+  {
+    min_x = fmin(min_x, sim_nodes[i].x);
+    min_y = fmin(min_y, sim_nodes[i].y);
+    max_x = fmax(max_x, sim_nodes[i].x);
+    max_y = fmax(max_y, sim_nodes[i].y);
+  }
+
+  uint32_t cols = (uint32_t)((max_x - min_x) / sense) + 1;
+  uint32_t rows = (uint32_t)((max_y - min_y) / sense) + 1;
+  uint32_t *head = malloc((size_t)cols * rows * sizeof(uint32_t));
+  uint32_t *next = malloc(sim_n_nodes * sizeof(uint32_t));
+  uint32_t *cell = malloc(sim_n_nodes * sizeof(uint32_t));
+
+  for (size_t c = 0; c < (size_t)cols * rows; c++)
+  {
+    head[c] = SIM_NO_NODE;
+  }
+  for (uint32_t i = 0; i < sim_n_nodes; i++)
+  {
+    uint32_t cx = (uint32_t)((sim_nodes[i].x - min_x) / sense);
+    uint32_t cy = (uint32_t)((sim_nodes[i].y - min_y) / sense);
+    cell[i] = cy * cols + cx;
+    next[i] = head[cell[i]];
+    head[cell[i]] = i;
+  }
+
+  for (uint32_t i = 0; i < sim_n_nodes; i++)
+  {
+    struct sim_node *n = &sim_nodes[i];
+    uint32_t cap = 0;
+    int32_t cx = cell[i] % cols, cy = cell[i] / cols;
+
+    for (int32_t y = cy - 1; y <= cy + 1; y++)
+    {
+      for (int32_t x = cx - 1; x <= cx + 1; x++)
+      {
+        if (x < 0 || y < 0 || x >= (int32_t)cols || y >= (int32_t)rows)
+        {
+          continue;
+        }
+        for (uint32_t j = head[y * cols + x]; j != SIM_NO_NODE; j = next[j])
+        {
+          struct sim_link l = {j, 0.0f, 0, 0};
+          if (j == i || !sim_config.model->link(hypot(n->x - sim_nodes[j].x, n->y - sim_nodes[j].y), &l))
+          {
+            continue;
+          }
+          if (n->n_links == cap)
+          {
+            cap = cap ? cap * 2 : 8;
+            n->links = realloc(n->links, cap * sizeof(struct sim_link));
+          }
+          n->links[n->n_links++] = l;
+        }
+      }
+    }
+  }
+
+  free(head);
+  free(next);
+  free(cell);
+}
+/*---------------------------------------------------------------------------*/
+void sim_radio_account(struct sim_node *n)
+{
+  if (n->radio_on && sim_now > n->on_since)
+  {
+    n->rx_time += sim_now - n->on_since;
+    n->on_since = sim_now;
+  }
+}
+
+static void
+deliver(struct sim_node *src, const struct sim_link *l)
+{
+  sim_switch(l->dst);
+  packetbuf_clear();
+  packetbuf_copyfrom(src->tx_buf, src->tx_len);
+  packetbuf_set_attr(PACKETBUF_ATTR_RSSI, (packetbuf_attr_t)l->rssi);
+  packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, l->lqi);
+  packetbuf_set_attr(PACKETBUF_ATTR_CHANNEL, src->tx_channel);
+  /* start of frame, as timestamped by the cc2420 */
+  packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP,
+                     (rtimer_clock_t)sim_ticks(src->tx_start + SHR_LEN * BYTE_TIME_US));
+  NETSTACK_RDC.input();
+}
+
+void sim_radio_tx_end(uint32_t src, uint32_t serial)
+{
+  struct sim_node *s = &sim_nodes[src];
+
+  for (uint32_t i = 0; i < s->n_links; i++)
+  {
+    const struct sim_link *l = &s->links[i];
+    struct sim_node *r = &sim_nodes[l->dst];
+
+    if (sim_config.collisions)
+    {
+      if (r->lock_src != src || r->lock_serial != serial)
+      {
+        continue;
+      }
+      r->lock_src = SIM_NO_NODE;
+      if (r->lock_corrupt)
+      {
+        sim_rx_collisions++;
+        continue;
+      }
+    }
+    else if (l->prr <= 0.0f || !r->radio_on || r->channel != s->tx_channel ||
+             r->listen_since > s->tx_start || r->tx_until > s->tx_start)
+    {
+      continue;
+    }
+
+    if (l->prr < 1.0f && sim_rand_unit() >= l->prr)
+    {
+      continue;
+    }
+    deliver(s, l);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+init(void)
+{
+  return 0;
+}
+
+static int
+prepare(const void *payload, unsigned short payload_len)
+{
+  struct sim_node *n = sim_node();
+
+  if (payload_len > SIM_FRAME_MAX)
+  {
+    return RADIO_TX_ERR;
+  }
+  memcpy(n->prep_buf, payload, payload_len);
+  n->prep_len = payload_len;
+  return 0;
+}
+
+static int
+channel_clear(void)
+{
+  return !sim_config.collisions || sim_node()->busy_until <= sim_now;
+}
+
+static int
+transmit(unsigned short transmit_len)
+{
+  struct sim_node *n = sim_node();
+  uint32_t self = sim_current;
+
+  if (n->tx_until > sim_now)
+  {
+    return RADIO_TX_ERR;
+  }
+  /* the cc2420 and cc2538 drivers check the channel before sending */
+  if (!channel_clear())
+  {
+    return RADIO_TX_COLLISION;
+  }
+
+  sim_radio_account(n);
+  memcpy(n->tx_buf, n->prep_buf, n->prep_len);
+  n->tx_len = transmit_len < n->prep_len ? transmit_len : n->prep_len;
+  n->tx_channel = n->channel;
+  n->tx_serial++;
+  n->tx_start = sim_now;
+  n->tx_until = sim_now + (sim_time_t)(n->tx_len + PHY_OVERHEAD) * BYTE_TIME_US;
+  n->tx_time += n->tx_until - sim_now;
+  n->lock_src = SIM_NO_NODE;
+  if (n->radio_on)
+  {
+    /* back to listening once the frame is out */
+    n->on_since = n->tx_until;
+    n->listen_since = n->tx_until;
+  }
+
+  if (sim_config.collisions)
+  {
+    for (uint32_t i = 0; i < n->n_links; i++)
+    {
+      const struct sim_link *l = &n->links[i];
+      struct sim_node *r = &sim_nodes[l->dst];
+
+      if (r->channel != n->tx_channel)
+      {
+        continue;
+      }
+      if (r->busy_until > sim_now)
+      {
+        /* overlapping signals destroy the frame being received, and
+           this one is not received either */
+        r->lock_corrupt = 1;
+        if (l->prr > 0.0f && r->radio_on && r->tx_until <= sim_now)
+        {
+          sim_rx_collisions++;
+        }
+      }
+      else if (l->prr > 0.0f && r->radio_on && r->tx_until <= sim_now)
+      {
+        r->lock_src = self;
+        r->lock_serial = n->tx_serial;
+        r->lock_corrupt = 0;
+      }
+      if (r->busy_until < n->tx_until)
+      {
+        r->busy_until = n->tx_until;
+      }
+    }
+  }
+
+  sim_schedule(n->tx_until, SIM_EV_TX_END, self, n->tx_serial, NULL, NULL);
+  return RADIO_TX_OK;
+}
+
+static int
+send(const void *payload, unsigned short payload_len)
+{
+  int ret = prepare(payload, payload_len);
+  return ret == 0 ? transmit(payload_len) : ret;
+}
+
+static int
+read(void *buf, unsigned short buf_len)
+{
+  return 0;
+}
+
+static int
+receiving_packet(void)
+{
+  return sim_node()->lock_src != SIM_NO_NODE;
+}
+
+static int
+pending_packet(void)
+{
+  return 0;
+}
+
+static int
+on(void)
+{
+  struct sim_node *n = sim_node();
+
+  if (!n->radio_on)
+  {
+    n->radio_on = 1;
+    n->on_since = n->tx_until > sim_now ? n->tx_until : sim_now;
+    n->listen_since = n->on_since;
+  }
+  return 1;
+}
+
+static int
+off(void)
+{
+  struct sim_node *n = sim_node();
+
+  sim_radio_account(n);
+  n->radio_on = 0;
+  n->lock_src = SIM_NO_NODE;
+  return 1;
+}
+
+static radio_result_t
+get_value(radio_param_t param, radio_value_t *value)
+{
+  struct sim_node *n = sim_node();
+
+  switch (param)
+  {
+  case RADIO_PARAM_POWER_MODE:
+    *value = n->radio_on ? RADIO_POWER_MODE_ON : RADIO_POWER_MODE_OFF;
+    return RADIO_RESULT_OK;
+  case RADIO_PARAM_CHANNEL:
+    *value = n->channel;
+    return RADIO_RESULT_OK;
+  case RADIO_PARAM_RX_MODE:
+  case RADIO_PARAM_TX_MODE:
+  case RADIO_PARAM_TXPOWER:
+    *value = 0;
+    return RADIO_RESULT_OK;
+  case RADIO_CONST_CHANNEL_MIN:
+    *value = CHANNEL_MIN;
+    return RADIO_RESULT_OK;
+  case RADIO_CONST_CHANNEL_MAX:
+    *value = CHANNEL_MAX;
+    return RADIO_RESULT_OK;
+  default:
+    return RADIO_RESULT_NOT_SUPPORTED;
+  }
+}
+
+static radio_result_t
+set_value(radio_param_t param, radio_value_t value)
+{
+  struct sim_node *n = sim_node();
+
+  switch (param)
+  {
+  case RADIO_PARAM_CHANNEL:
+    if (value < CHANNEL_MIN || value > CHANNEL_MAX)
+    {
+      return RADIO_RESULT_INVALID_VALUE;
+    }
+    if (n->channel != value)
+    {
+      n->channel = (uint8_t)value;
+      n->lock_src = SIM_NO_NODE;
+      n->busy_until = 0;
+      n->listen_since = sim_now;
+      /* the links are symmetric: sense what is already on the air there */
+      for (uint32_t i = 0; i < n->n_links; i++)
+      {
+        const struct sim_node *s = &sim_nodes[n->links[i].dst];
+        if (s->tx_until > n->busy_until && s->tx_channel == n->channel)
+        {
+          n->busy_until = s->tx_until;
+        }
+      }
+    }
+    return RADIO_RESULT_OK;
+  case RADIO_PARAM_POWER_MODE:
+    return value == RADIO_POWER_MODE_ON ? (on(), RADIO_RESULT_OK) : (off(), RADIO_RESULT_OK);
+  case RADIO_PARAM_RX_MODE:
+  case RADIO_PARAM_TX_MODE:
+  case RADIO_PARAM_TXPOWER:
+    return RADIO_RESULT_OK;
+  default:
+    return RADIO_RESULT_NOT_SUPPORTED;
+  }
+}
+
+static radio_result_t
+get_object(radio_param_t param, void *dest, size_t size)
+{
+  if (param == RADIO_PARAM_64BIT_ADDR && size >= 8)
+  {
+    uint16_t id = sim_node()->id;
+    uint8_t addr[8] = {0x00, 0x12, 0x4B, 0x00, 0x00, 0x00, id >> 8, id & 0xff};
+    memcpy(dest, addr, 8);
+    return RADIO_RESULT_OK;
+  }
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+
+static radio_result_t
+set_object(radio_param_t param, const void *src, size_t size)
+{
+  return RADIO_RESULT_NOT_SUPPORTED;
+}
+/*---------------------------------------------------------------------------*/
+const struct radio_driver sim_radio_driver = {
+    init,
+    prepare,
+    transmit,
+    send,
+    read,
+    channel_clear,
+    receiving_packet,
+    pending_packet,
+    on,
+    off,
+    get_value,
+    set_value,
+    get_object,
+    set_object};
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,483 @@
+/*---------------------------------------------------------------------------*/
+/* ND simulator: event queue, per-node context switching and command line */
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+/*---------------------------------------------------------------------------*/
+/* Bounds of the per-node image, defined by the linker (see Makefile) */
+extern uint8_t __start_nd_state[];
+extern uint8_t __stop_nd_state[];
+
+struct sim_config sim_config = {
+    .n_nodes = 50,
+    .range = 50.0,
+    .side = 0.0,
+    .degree = 10.0,
+    .loss = 0.0,
+    .collisions = 1,
+    .seed = 1,
+    .duration = 200 * SIM_SECOND,
+    .model = NULL,
+    .csc = NULL};
+
+struct sim_node *sim_nodes;
+uint32_t sim_n_nodes;
+uint32_t sim_current = SIM_NO_NODE;
+sim_time_t sim_now;
+FILE *sim_out;
+/*---------------------------------------------------------------------------*/
+/* Event payloads live in a pool; the 4-ary heap only moves (key, slot) pairs.
+ * The key is the event time in the upper 40 bits and a sequence number in
+ * the lower 24, so events due at the same time run in FIFO order.
+ */
+#define SEQ_BITS 24
+#define HEAP_ARITY 4
+
+struct sim_event
+{
+  void *p;
+  void *data;
+  uint32_t node;
+  uint32_t arg;
+  uint8_t type;
+};
+
+struct heap_entry
+{
+  uint64_t key;
+  uint32_t slot;
+};
+
+static struct heap_entry *heap;
+static size_t heap_len;
+static size_t heap_cap;
+static uint64_t heap_seq;
+static struct sim_event *pool;
+static uint32_t *pool_free;
+static size_t pool_free_len;
+static uint64_t events_run;
+static size_t image_size;
+static uint64_t rng_state;
+/*---------------------------------------------------------------------------*/
+void sim_schedule(sim_time_t time, uint8_t type, uint32_t node, uint32_t arg,
+                  void *p, void *data)
+{
+  if (heap_len == heap_cap)
+  {
+    size_t cap = heap_cap ? heap_cap * 2 : 1024;
+    heap = realloc(heap, cap * sizeof(*heap));
+    pool = realloc(pool, cap * sizeof(*pool));
+    pool_free = realloc(pool_free, cap * sizeof(*pool_free));
+    if (heap == NULL || pool == NULL || pool_free == NULL)
+    {
+      perror("sim: event queue");
+      exit(EXIT_FAILURE);
+    }
+    for (size_t s = cap; s > heap_cap; s--)
+    {
+      pool_free[pool_free_len++] = (uint32_t)(s - 1);
+    }
+    heap_cap = cap;
+  }
+
+  uint32_t slot = pool_free[--pool_free_len];
+  pool[slot] = (struct sim_event){p, data, node, arg, type};
+
+  struct heap_entry e = {(time << SEQ_BITS) | (heap_seq++ & ((1 << SEQ_BITS) - 1)), slot};
+  size_t i = heap_len++;
+  while (i > 0 && e.key < heap[(i - 1) / HEAP_ARITY].key)
+  {
+    heap[i] = heap[(i - 1) / HEAP_ARITY];
+    i = (i - 1) / HEAP_ARITY;
+  }
+  heap[i] = e;
+}
+
+static struct heap_entry
+pop_event(void)
+{
+  struct heap_entry top = heap[0];
+  struct heap_entry last = heap[--heap_len];
+  size_t i = 0;
+
+  for (;;)
+  {
+    size_t first = HEAP_ARITY * i + 1;
+    size_t best = first;
+    if (first >= heap_len)
+    {
+      break;
+    }
+    for (size_t c = first + 1; c < first + HEAP_ARITY && c < heap_len; c++)
+    {
+      if (heap[c].key < heap[best].key)
+      {
+        best = c;
+      }
+    }
+    if (heap[best].key >= last.key)
+    {
+      break;
+    }
+    heap[i] = heap[best];
+    i = best;
+  }
+  if (heap_len > 0)
+  {
+    heap[i] = last;
+  }
+  pool_free[pool_free_len++] = top.slot;
+  return top;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Load the image of a node into the nd_state section
+ */
+void sim_switch(uint32_t node)
+{
+  if (node == sim_current)
+  {
+    return;
+  }
+  if (sim_current != SIM_NO_NODE)
+  {
+    memcpy(sim_nodes[sim_current].image, __start_nd_state, image_size);
+  }
+  memcpy(__start_nd_state, sim_nodes[node].image, image_size);
+  sim_current = node;
+}
+/*---------------------------------------------------------------------------*/
+/* Rate error of the current node's clock, none outside the nodes */
+static int64_t current_skew(void)
+{
+  return sim_current == SIM_NO_NODE ? 0 : sim_nodes[sim_current].skew_ppb;
+}
+
+uint64_t sim_ticks(sim_time_t t)
+{
+  unsigned __int128 rate = 1000000000 + current_skew();
+
+  return (uint64_t)((unsigned __int128)t * RTIMER_SECOND * rate /
+                    ((unsigned __int128)SIM_SECOND * 1000000000));
+}
+
+sim_time_t sim_ticks_to_time(uint64_t ticks)
+{
+  unsigned __int128 rate = 1000000000 + current_skew();
+  unsigned __int128 num = (unsigned __int128)ticks * SIM_SECOND * 1000000000;
+  unsigned __int128 den = (unsigned __int128)RTIMER_SECOND * rate;
+
+  return (sim_time_t)((num + den - 1) / den);
+}
+
+uint32_t sim_rand(void)
+{
+  /* xorshift64* */
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (uint32_t)((rng_state * 2685821657736338717ULL) >> 32);
+}
+
+double sim_rand_unit(void)
+{
+  return sim_rand() / 4294967296.0;
+}
+/*---------------------------------------------------------------------------*/
+/* Mote blocks, as opposed to the <mote>N</mote> entries of the plugins */
+static char *
+csc_next_mote(char *from)
+{
+  char *m;
+  for (m = strstr(from, "<mote>"); m != NULL; m = strstr(m + 1, "<mote>"))
+  {
+    if (m[6] == '\n' || m[6] == '\r' || m[6] == ' ')
+    {
+      return m;
+    }
+  }
+  return NULL;
+}
+
+static char *
+csc_value(const char *from, const char *end, const char *tag)
+{
+  char *p = strstr(from, tag);
+  return (p != NULL && p < end) ? p + strlen(tag) : NULL;
+}
+
+/**
+ * Take mote IDs and positions from a Cooja .csc file
+ */
+static uint32_t
+load_csc(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *text = malloc(len + 1);
+  if (text == NULL || fread(text, 1, len, f) != (size_t)len)
+  {
+    fprintf(stderr, "sim: cannot read %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  text[len] = '\0';
+  fclose(f);
+
+  uint32_t n = 0;
+  for (char *m = csc_next_mote(text); m != NULL; m = csc_next_mote(m + 1))
+  {
+    n++;
+  }
+  sim_nodes = calloc(n, sizeof(*sim_nodes));
+
+  uint32_t i = 0;
+  for (char *m = csc_next_mote(text); m != NULL; m = csc_next_mote(m + 1))
+  {
+    char *end = strstr(m, "</mote>");
+    char *x = csc_value(m, end, "<x>");
+    char *y = csc_value(m, end, "<y>");
+    char *id = csc_value(m, end, "<id>");
+    if (end == NULL || x == NULL || y == NULL || id == NULL)
+    {
+      fprintf(stderr, "sim: malformed mote %u in %s\n", i, path);
+      exit(EXIT_FAILURE);
+    }
+    sim_nodes[i].x = strtod(x, NULL);
+    sim_nodes[i].y = strtod(y, NULL);
+    sim_nodes[i].id = (uint16_t)strtoul(id, NULL, 10);
+    i++;
+  }
+  free(text);
+  return n;
+}
+
+static void
+place_nodes(void)
+{
+  if (sim_config.csc != NULL)
+  {
+    sim_n_nodes = load_csc(sim_config.csc);
+    return;
+  }
+
+  sim_n_nodes = sim_config.n_nodes;
+  if (sim_config.side <= 0)
+  {
+    /* pick the area that gives the requested average degree */
+    sim_config.side = sqrt(sim_n_nodes * M_PI * sim_config.range * sim_config.range / sim_config.degree);
+  }
+  sim_nodes = calloc(sim_n_nodes, sizeof(*sim_nodes));
+  for (uint32_t i = 0; i < sim_n_nodes; i++)
+  {
+    sim_nodes[i].id = (uint16_t)(i + 1);
+    sim_nodes[i].x = sim_rand_unit() * sim_config.side;
+    sim_nodes[i].y = sim_rand_unit() * sim_config.side;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(void)
+{
+  while (heap_len > 0)
+  {
+    struct heap_entry top = pop_event();
+    struct sim_event ev = pool[top.slot];
+    if ((top.key >> SEQ_BITS) > sim_config.duration)
+    {
+      break;
+    }
+    sim_now = top.key >> SEQ_BITS;
+    events_run++;
+
+    switch (ev.type)
+    {
+    case SIM_EV_BOOT:
+      sim_switch(ev.node);
+      sim_boot();
+      break;
+    case SIM_EV_RTIMER:
+      if (ev.arg == sim_nodes[ev.node].rt_gen)
+      {
+        sim_switch(ev.node);
+        sim_rtimer_fire(ev.p);
+      }
+      break;
+    case SIM_EV_ETIMER:
+      sim_switch(ev.node);
+      sim_etimer_fire(ev.p, ev.arg);
+      break;
+    case SIM_EV_PROCESS:
+      sim_switch(ev.node);
+      sim_process_dispatch(ev.p, (process_event_t)ev.arg, ev.data);
+      break;
+    case SIM_EV_TX_END:
+      sim_radio_tx_end(ev.node, ev.arg);
+      break;
+    case SIM_EV_ENERGEST:
+      sim_switch(ev.node);
+      sim_energest_report();
+      break;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -n N       number of nodes (default %u)\n"
+          "  -c FILE    take node IDs and positions from a Cooja .csc file\n"
+          "  -r M       transmission range in meters (default %.0f)\n"
+          "  -a M       side of the square area, overrides -d\n"
+          "  -d DEG     target average node degree (default %.0f)\n"
+          "  -m MODEL   radio model (default %s)\n"
+          "  -l P       loss probability (default %.2f)\n"
+          "  -C         ideal medium: no collisions, CCA always clear\n"
+          "  -k PPM     clock drift, each crystal is off by up to PPM (default 0)\n"
+          "  -t SEC     simulated time in seconds (default %llu)\n"
+          "  -s SEED    random seed (default %llu)\n"
+          "  -o FILE    write the log to FILE instead of stdout\n"
+          "radio models:\n",
+          prog, sim_config.n_nodes, sim_config.range, sim_config.degree,
+          sim_radio_models[0]->name, sim_config.loss,
+          (unsigned long long)(sim_config.duration / SIM_SECOND),
+          (unsigned long long)sim_config.seed);
+  for (int i = 0; sim_radio_models[i] != NULL; i++)
+  {
+    fprintf(stderr, "  %-10s %s\n", sim_radio_models[i]->name, sim_radio_models[i]->description);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *out_path = NULL;
+  int opt;
+
+  sim_config.model = sim_radio_models[0];
+  while ((opt = getopt(argc, argv, "n:c:r:a:d:m:l:Ck:t:s:o:h")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      sim_config.n_nodes = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'c':
+      sim_config.csc = optarg;
+      break;
+    case 'r':
+      sim_config.range = strtod(optarg, NULL);
+      break;
+    case 'a':
+      sim_config.side = strtod(optarg, NULL);
+      break;
+    case 'd':
+      sim_config.degree = strtod(optarg, NULL);
+      break;
+    case 'm':
+      sim_config.model = NULL;
+      for (int i = 0; sim_radio_models[i] != NULL; i++)
+      {
+        if (strcmp(sim_radio_models[i]->name, optarg) == 0)
+        {
+          sim_config.model = sim_radio_models[i];
+        }
+      }
+      if (sim_config.model == NULL)
+      {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'l':
+      sim_config.loss = strtod(optarg, NULL);
+      break;
+    case 'C':
+      sim_config.collisions = 0;
+      break;
+    case 'k':
+      sim_config.drift = strtod(optarg, NULL);
+      break;
+    case 't':
+      sim_config.duration = (sim_time_t)(strtod(optarg, NULL) * SIM_SECOND);
+      break;
+    case 's':
+      sim_config.seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  if (sim_config.n_nodes == 0 || sim_config.n_nodes > 65535)
+  {
+    fprintf(stderr, "sim: the number of nodes must be in 1..65535\n");
+    return EXIT_FAILURE;
+  }
+  if ((sim_config.duration >> (64 - SEQ_BITS)) != 0)
+  {
+    fprintf(stderr, "sim: simulated time too long\n");
+    return EXIT_FAILURE;
+  }
+
+  sim_out = stdout;
+  if (out_path != NULL && (sim_out = fopen(out_path, "w")) == NULL)
+  {
+    perror(out_path);
+    return EXIT_FAILURE;
+  }
+  setvbuf(sim_out, NULL, _IOFBF, 1 << 20);
+
+  rng_state = sim_config.seed * 0x9E3779B97F4A7C15ULL + 1;
+  srand((unsigned)sim_config.seed); /* nd.c draws its offsets from rand() */
+
+  place_nodes();
+  sim_radio_build_links();
+
+  /* every node starts from the pristine image of the node objects */
+  image_size = __stop_nd_state - __start_nd_state;
+  for (uint32_t i = 0; i < sim_n_nodes; i++)
+  {
+    sim_nodes[i].image = malloc(image_size);
+    memcpy(sim_nodes[i].image, __start_nd_state, image_size);
+    sim_nodes[i].lock_src = SIM_NO_NODE;
+    sim_nodes[i].channel = 26;
+    sim_nodes[i].last_event = PROCESS_EVENT_MAX;
+    if (sim_config.drift > 0.0)
+    {
+      sim_nodes[i].skew_ppb = (int32_t)((2.0 * sim_rand_unit() - 1.0) * sim_config.drift * 1000.0);
+    }
+    /* motes boot within the first second, like Cooja's start-up delay */
+    sim_schedule(sim_rand() % SIM_SECOND, SIM_EV_BOOT, i, 0, NULL, NULL);
+  }
+
+  clock_t wall = clock();
+  run();
+  double wall_s = (double)(clock() - wall) / CLOCKS_PER_SEC;
+
+  fflush(sim_out);
+  fprintf(stderr,
+          "sim: %u nodes, %s model, %.0f s simulated in %.2f s (%.0fx real time), "
+          "%llu events, %zu bytes of state per node, %llu receptions lost to collisions\n",
+          sim_n_nodes, sim_config.model->name, (double)sim_config.duration / SIM_SECOND,
+          wall_s, wall_s > 0 ? (double)sim_config.duration / SIM_SECOND / wall_s : 0.0,
+          (unsigned long long)events_run, image_size, sim_rx_collisions);
+  return EXIT_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,143 @@
+/*---------------------------------------------------------------------------*/
+/* Host-native discrete-event simulator for the ND primitives.
+ *
+ * nd.c, nd-rdc.c and app.c are linked unmodified against the stubs in
+ * sim-contiki.c (rtimer, etimer, processes, packetbuf, printf) and
+ * sim-radio.c (radio driver and medium). All their writable data lives in
+ * the nd_state section, which is swapped in and out for every node.
+ */
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "contiki.h"
+/*---------------------------------------------------------------------------*/
+typedef uint64_t sim_time_t; /* simulated time in microseconds */
+
+#define SIM_SECOND 1000000ULL
+#define SIM_NO_NODE UINT32_MAX
+#define SIM_FRAME_MAX 128
+
+enum sim_event_type {
+  SIM_EV_BOOT,
+  SIM_EV_RTIMER,
+  SIM_EV_ETIMER,
+  SIM_EV_PROCESS,
+  SIM_EV_TX_END,
+  SIM_EV_ENERGEST,
+};
+/*---------------------------------------------------------------------------*/
+/* Directed link towards a node that senses our transmissions */
+struct sim_link {
+  uint32_t dst;
+  float prr;    /* packet reception ratio, 0 for interference only */
+  int8_t rssi;  /* dBm */
+  uint8_t lqi;
+};
+
+struct sim_node {
+  /* rtimer: a single pending task, as on the real hardware */
+  struct rtimer *rt;
+  uint32_t rt_gen;
+
+  /* radio */
+  uint8_t radio_on;
+  uint8_t channel;
+  uint8_t tx_channel;
+  uint8_t lock_corrupt;
+  uint32_t lock_src; /* frame being received, SIM_NO_NODE if none */
+  uint32_t lock_serial;
+  uint32_t tx_serial;
+  sim_time_t on_since;     /* start of the current rx accounting interval */
+  sim_time_t listen_since; /* radio continuously listening since */
+  sim_time_t busy_until;   /* end of the last signal sensed on our channel */
+  sim_time_t tx_start, tx_until;
+  uint16_t tx_len, prep_len;
+
+  uint16_t id;
+  int32_t skew_ppb; /* rate error of the node's crystal, parts per billion */
+  process_event_t last_event;
+  double x, y;
+  uint8_t *image; /* saved nd_state section of this node */
+  struct sim_link *links;
+  uint32_t n_links;
+
+  /* energest, in microseconds */
+  sim_time_t tx_time, rx_time;
+  uint64_t energest_tx, energest_rx; /* ticks at the last report */
+  unsigned long energest_cnt;
+
+  /* serial output, flushed line by line */
+  uint16_t line_len;
+  char line[256];
+
+  uint8_t prep_buf[SIM_FRAME_MAX];
+  uint8_t tx_buf[SIM_FRAME_MAX];
+};
+/*---------------------------------------------------------------------------*/
+/* Pluggable radio model: decides which nodes sense each other */
+struct sim_radio_model {
+  const char *name;
+  const char *description;
+  double sense_factor; /* sensing range as a multiple of the tx range */
+  /* Fill in l for a link of length dist, return 0 if it is not sensed */
+  int (* link)(double dist, struct sim_link *l);
+};
+
+struct sim_config {
+  uint32_t n_nodes;
+  double range;    /* transmission range [m] */
+  double side;     /* side of the square deployment area [m] */
+  double degree;   /* target average degree when side is not given */
+  double loss;     /* loss probability, see the radio models */
+  int collisions;  /* model collisions and CCA */
+  double drift;    /* crystals are off by up to this, in ppm */
+  uint64_t seed;
+  sim_time_t duration;
+  const struct sim_radio_model *model;
+  const char *csc; /* take positions and IDs from a Cooja simulation */
+};
+/*---------------------------------------------------------------------------*/
+extern struct sim_config sim_config;
+extern struct sim_node *sim_nodes;
+extern uint32_t sim_n_nodes;
+extern uint32_t sim_current;
+extern sim_time_t sim_now;
+extern FILE *sim_out;
+
+void sim_schedule(sim_time_t time, uint8_t type, uint32_t node, uint32_t arg,
+                  void *p, void *data);
+void sim_switch(uint32_t node);
+
+static inline struct sim_node *
+sim_node(void)
+{
+  return &sim_nodes[sim_current];
+}
+
+/* Conversions on the clock of the current node */
+uint64_t sim_ticks(sim_time_t t);
+sim_time_t sim_ticks_to_time(uint64_t ticks);
+uint32_t sim_rand(void);
+double sim_rand_unit(void);
+
+/* sim-contiki.c */
+void sim_boot(void);
+void sim_process_dispatch(struct process *p, process_event_t ev,
+                          process_data_t data);
+void sim_rtimer_fire(struct rtimer *t);
+void sim_etimer_fire(struct etimer *et, uint32_t gen);
+void sim_energest_report(void);
+int sim_printf(const char *fmt, ...);
+
+/* sim-radio.c */
+extern const struct sim_radio_model *const sim_radio_models[];
+extern unsigned long long sim_rx_collisions;
+void sim_radio_build_links(void);
+void sim_radio_account(struct sim_node *n);
+void sim_radio_tx_end(uint32_t src, uint32_t serial);
+
+#endif /* SIM_H_ */
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+"""Evaluates the tick constants of nd.c, nd-rdc.h and nd-trace.h as the
+16 bit int of sky computes them, and fails if any differs from its value
+with the 32 bit int of the host. The simulator is built with the latter, so
+a product such as RTIMER_SECOND * 35, which wraps on sky, goes unnoticed by
+its build and by the ND_STATIC_ASSERT() checks there.
+
+The constants are expanded by the C preprocessor with the flags of the node
+build, then evaluated here with the C conversions of each target.
+
+    ./ticks16.py ND_CONF_EPOCH_INTERVAL_RT=16384
+"""
+import os
+import re
+import subprocess
+import sys
+
+# the constants checked, each an expression of the macros in scope in nd.c
+CONSTANTS = [
+    "EPOCH_DURATION",
+    "TICKS_PER_SEC",
+    "TICKS_PER_MILLISEC",
+    "TRANSMISSION_WINDOW_COUNT_SCATTER",
+    "WINDOW_LEN_BURST",
+    "WINDOW_LEN_SCATTER",
+    "TRANSMISSION_DURATION_BURST",
+    "TRANSMISSION_DURATION_SCATTER",
+    "TRANSMISSION_PER_WINDOW_BURST",
+    "RECEPTION_DURATION_BURST",
+    "RECEPTION_DURATION_SCATTER",
+    "ND_BEACON_TICKS",
+    "ND_SLOT_TICKS",
+    "ND_SLOT_PAD",
+    "ND_RDV_TX_DELAY",
+    "ND_RDV_GUARD",
+    "ND_RDV_DRIFT_JUMP",
+    "ND_COLLISION_OFFSET_MAX",
+    "ND_RDC_BACKOFF_UNIT",
+    "ND_RDC_CCA_TICKS",
+    "ND_RDC_AIRTIME(12)",
+    "ND_TRACE_DUMP_LATE",
+]
+
+# integer types: rank, bits, signed. rank orders the conversions of C.
+SKY = {"int": 16, "long": 32}
+HOST = {"int": 32, "long": 64}
+
+
+def types(model):
+    t = {
+        "char": (1, 8, True),
+        "unsigned char": (1, 8, False),
+        "short": (2, 16, True),
+        "unsigned short": (2, 16, False),
+        "int": (3, model["int"], True),
+        "unsigned": (3, model["int"], False),
+        "unsigned int": (3, model["int"], False),
+        "long": (4, model["long"], True),
+        "unsigned long": (4, model["long"], False),
+        "long long": (5, 64, True),
+        "unsigned long long": (5, 64, False),
+    }
+    # the fixed width types, as on sky; rtimer_clock_t is 16 bits there
+    for name, base in (("int8_t", "char"), ("uint8_t", "unsigned char"),
+                       ("int16_t", "short"), ("uint16_t", "unsigned short"),
+                       ("rtimer_clock_t", "unsigned short")):
+        t[name] = t[base]
+    for name, bits in (("int32_t", 32), ("uint32_t", 32), ("int64_t", 64), ("uint64_t", 64)):
+        signed = not name.startswith("u")
+        t[name] = next(v for v in t.values() if v[1] == bits and v[2] == signed and v[0] >= 3)
+    return t
+
+
+class Value:
+    def __init__(self, v, ty):
+        self.ty = ty
+        bits, signed = ty[1], ty[2]
+        v &= (1 << bits) - 1
+        if signed and v >> (bits - 1):
+            v -= 1 << bits
+        self.v = v
+
+
+class Evaluator:
+    """Recursive descent over the arithmetic of C constant expressions"""
+
+    def __init__(self, model):
+        self.types = types(model)
+        self.int = self.types["int"]
+
+    def promote(self, a):
+        rank, bits, signed = a.ty
+        if rank < 3:
+            fits = bits < self.int[1] or (bits == self.int[1] and signed)
+            return Value(a.v, self.int if fits else self.types["unsigned"])
+        return a
+
+    def common(self, a, b):
+        a, b = self.promote(a), self.promote(b)
+        if a.ty == b.ty:
+            return a.ty
+        hi, lo = (a.ty, b.ty) if a.ty[0] >= b.ty[0] else (b.ty, a.ty)
+        if hi[2] == lo[2] or not hi[2]:
+            return hi
+        if hi[1] > lo[1]:
+            return hi  # the signed type holds every value of the unsigned one
+        return next(t for t in self.types.values() if t[0] == hi[0] and not t[2])
+
+    def literal(self, tok):
+        m = re.fullmatch(r"(0[xX][0-9a-fA-F]+|\d+)([uUlL]*)", tok)
+        v = int(m.group(1), 0)
+        suffix = m.group(2).lower()
+        unsigned_ok = "u" in suffix or m.group(1)[:2].lower() == "0x"
+        names = ["int", "unsigned int", "long", "unsigned long", "long long", "unsigned long long"]
+        if "l" in suffix:
+            names = names[2:]
+        for name in names:
+            ty = self.types[name]
+            if (not ty[2] and not unsigned_ok) or ("u" in suffix and ty[2]):
+                continue
+            if v < 1 << (ty[1] - ty[2]):
+                return Value(v, ty)
+        raise ValueError(f"literal {tok} too large")
+
+    def parse(self, text):
+        self.toks = re.findall(r"0[xX][0-9a-fA-F]+[uUlL]*|\d+[uUlL]*|\w+|<<|>>|<=|>=|==|!=|\S", text)
+        self.pos = 0
+        v = self.expr()
+        if self.pos != len(self.toks):
+            raise ValueError(f"unexpected {self.toks[self.pos]!r}")
+        return v.v
+
+    def peek(self):
+        return self.toks[self.pos] if self.pos < len(self.toks) else None
+
+    def take(self, tok=None):
+        t = self.peek()
+        if tok is not None and t != tok:
+            raise ValueError(f"expected {tok!r}, got {t!r}")
+        self.pos += 1
+        return t
+
+    def binary(self, op, a, b):
+        if op in ("<<", ">>"):
+            a = self.promote(a)
+            return Value(a.v << b.v if op == "<<" else a.v >> b.v, a.ty)
+        ty = self.common(a, b)
+        x, y = Value(a.v, ty).v, Value(b.v, ty).v
+        if op == "+":
+            return Value(x + y, ty)
+        if op == "-":
+            return Value(x - y, ty)
+        if op == "*":
+            return Value(x * y, ty)
+        if y == 0:
+            raise ZeroDivisionError("division by 0")
+        q = abs(x) // abs(y) * (1 if (x < 0) == (y < 0) else -1)  # truncated, as in C
+        return Value(q if op == "/" else x - q * y, ty)
+
+    def expr(self):
+        v = self.term()
+        while self.peek() in ("+", "-", "<<", ">>"):
+            op = self.take()
+            v = self.binary(op, v, self.term())
+        return v
+
+    def term(self):
+        v = self.unary()
+        while self.peek() in ("*", "/", "%"):
+            op = self.take()
+            v = self.binary(op, v, self.unary())
+        return v
+
+    def cast_type(self):
+        # a type name in parentheses, or None
+        i = self.pos + 1
+        words = []
+        while i < len(self.toks) and re.fullmatch(r"[A-Za-z_]\w*", self.toks[i]):
+            words.append(self.toks[i])
+            i += 1
+        if words and i < len(self.toks) and self.toks[i] == ")":
+            name = " ".join(words)
+            if name in self.types:
+                self.pos = i + 1
+                return self.types[name]
+        return None
+
+    def unary(self):
+        t = self.peek()
+        if t == "(":
+            ty = self.cast_type()
+            if ty is not None:
+                return Value(self.unary().v, ty)
+            self.take("(")
+            v = self.expr()
+            self.take(")")
+            return v
+        if t in ("-", "+"):
+            self.take()
+            v = self.promote(self.unary())
+            return Value(-v.v if t == "-" else v.v, v.ty)
+        if t is not None and re.fullmatch(r"\d\w*", t):
+            self.take()
+            return self.literal(t)
+        raise ValueError(f"unexpected {t!r}")
+
+
+def expand(defines):
+    """The constants as the preprocessor expands them in nd.c"""
+    here = os.path.dirname(os.path.abspath(__file__))
+    src = '#include "nd.c"\n' + "".join(f"__nd_tick__ {i} {c}\n" for i, c in enumerate(CONSTANTS))
+    cmd = [os.environ.get("CC", "cc"), "-E", "-P", "-I" + os.path.join(here, "include"),
+           "-I" + os.path.dirname(here), '-DPROJECT_CONF_H="project-conf.h"', "-Dprintf=sim_printf"]
+    cmd += ["-D" + d for d in defines] + ["-"]
+    out = subprocess.run(cmd, input=src, capture_output=True, text=True, check=True).stdout
+    exprs = {}
+    for line in out.splitlines():
+        m = re.match(r"\s*__nd_tick__ (\d+) (.*)", line)
+        if m:
+            exprs[CONSTANTS[int(m.group(1))]] = m.group(2)
+    return exprs
+
+
+def main():
+    failed = False
+    for name, text in expand(sys.argv[1:]).items():
+        try:
+            host = Evaluator(HOST).parse(text)
+            sky = Evaluator(SKY).parse(text)
+        except (ValueError, ZeroDivisionError) as e:
+            print(f"{name}: {e} in {text}")
+            failed = True
+            continue
+        if sky != host:
+            print(f"{name} is {sky} with a 16 bit int, {host} with a 32 bit one: {text}")
+            failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())